@@ -119,6 +119,7 @@ int main(void) {
       event_callback, render_callback, update_callback, &d);
   cfg.backend = SAMURE_BACKEND_CAIRO;
   cfg.pointer_interaction = 1;
+  cfg.num_buffers = 2;
 
   SAMURE_RESULT(context) ctx_rs = samure_create_context(&cfg);
   SAMURE_RETURN_AND_PRINT_ON_ERROR(ctx_rs, "failed to create context", 1);
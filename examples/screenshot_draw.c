@@ -90,6 +90,7 @@ int main(int args, char *argv[]) {
   context_config.backend = SAMURE_BACKEND_CAIRO;
   context_config.pointer_interaction = 1;
   context_config.keyboard_interaction = 1;
+  context_config.sleep_when_idle = 1;
 
   SAMURE_RESULT(context) ctx_rs = samure_create_context(&context_config);
   if (ctx_rs.error != SAMURE_ERROR_NONE) {
@@ -102,6 +103,19 @@ int main(int args, char *argv[]) {
 
   struct samure_layer_surface **bgs = NULL;
 
+  struct samure_shared_buffer **screenshots =
+      malloc(ctx->num_outputs * sizeof(struct samure_shared_buffer *));
+  if (!screenshots) {
+    samure_perror("failed to allocate screenshots", SAMURE_ERROR_MEMORY);
+    samure_destroy_context(ctx);
+    return 1;
+  }
+  const samure_error screenshot_error =
+      samure_context_screenshot_all(ctx, screenshots, 0);
+  if (screenshot_error != SAMURE_ERROR_NONE) {
+    samure_perror("failed to take screenshot", screenshot_error);
+  }
+
   bgs = malloc(ctx->num_outputs * sizeof(struct samure_layer_surface *));
   for (size_t i = 0; i < ctx->num_outputs; i++) {
     bgs[i] = SAMURE_UNWRAP(
@@ -109,15 +123,12 @@ int main(int args, char *argv[]) {
         samure_create_layer_surface(ctx, ctx->outputs[i], SAMURE_LAYER_TOP,
                                     SAMURE_LAYER_SURFACE_ANCHOR_FILL, 0, 0, 0));
 
-    SAMURE_RESULT(shared_buffer) screenshot_rs = samure_output_screenshot(ctx, ctx->outputs[i], 0);
-    if (screenshot_rs.error != SAMURE_ERROR_NONE) {
-      samure_perror("failed to take screenshot", screenshot_rs.error);
-    } else {
-      struct samure_shared_buffer *screenshot = screenshot_rs.result;
-      samure_layer_surface_draw_buffer(bgs[i], screenshot);
-      samure_destroy_shared_buffer(screenshot);
+    if (screenshots[i]) {
+      samure_layer_surface_draw_buffer(bgs[i], screenshots[i]);
+      samure_destroy_shared_buffer(screenshots[i]);
     }
   }
+  free(screenshots);
 
   samure_context_set_render_state(ctx, SAMURE_RENDER_STATE_ONCE);
   samure_context_run(ctx);
@@ -60,6 +60,8 @@ struct samure_backend {
   samure_destroy_t destroy;
   samure_associate_layer_surface_t associate_layer_surface;
   samure_unassociate_layer_surface_t unassociate_layer_surface;
+  int thread_safe_rendering; // Whether on_render may run on the threads of
+                             // the worker pool (see parallel_rendering)
 };
 
 SAMURE_DEFINE_RESULT(backend);
@@ -31,34 +31,78 @@
 #include <string.h>
 
 samure_error
-_samure_cairo_surface_create_cairo(struct samure_cairo_surface *c) {
-  c->cairo_surface = cairo_image_surface_create_for_data(
-      (unsigned char *)c->buffer->data, CAIRO_FORMAT_ARGB32, c->buffer->width,
-      c->buffer->height,
-      cairo_format_stride_for_width(CAIRO_FORMAT_ARGB32, c->buffer->width));
-  if (cairo_surface_status(c->cairo_surface) != CAIRO_STATUS_SUCCESS) {
-    cairo_surface_destroy(c->cairo_surface);
+_samure_cairo_surface_create_cairo(struct samure_cairo_surface *c,
+                                   size_t index) {
+  struct samure_shared_buffer *b = c->swapchain.buffers[index];
+
+  c->cairo_surfaces[index] = cairo_image_surface_create_for_data(
+      (unsigned char *)b->data, CAIRO_FORMAT_ARGB32, b->width, b->height,
+      cairo_format_stride_for_width(CAIRO_FORMAT_ARGB32, b->width));
+  if (cairo_surface_status(c->cairo_surfaces[index]) != CAIRO_STATUS_SUCCESS) {
+    cairo_surface_destroy(c->cairo_surfaces[index]);
+    c->cairo_surfaces[index] = NULL;
     return SAMURE_ERROR_CAIRO_SURFACE_INIT;
   }
-  c->cairo = cairo_create(c->cairo_surface);
-  if (cairo_status(c->cairo) != CAIRO_STATUS_SUCCESS) {
-    cairo_surface_destroy(c->cairo_surface);
-    cairo_destroy(c->cairo);
+  c->cairos[index] = cairo_create(c->cairo_surfaces[index]);
+  if (cairo_status(c->cairos[index]) != CAIRO_STATUS_SUCCESS) {
+    cairo_surface_destroy(c->cairo_surfaces[index]);
+    cairo_destroy(c->cairos[index]);
+    c->cairo_surfaces[index] = NULL;
+    c->cairos[index] = NULL;
     return SAMURE_ERROR_CAIRO_INIT;
   }
 
   return SAMURE_ERROR_NONE;
 }
 
+void _samure_cairo_surface_destroy_cairo(struct samure_cairo_surface *c,
+                                         size_t index) {
+  if (c->cairos[index]) {
+    cairo_destroy(c->cairos[index]);
+    c->cairos[index] = NULL;
+  }
+  if (c->cairo_surfaces[index]) {
+    cairo_surface_destroy(c->cairo_surfaces[index]);
+    c->cairo_surfaces[index] = NULL;
+  }
+}
+
+void _samure_cairo_surface_select_current(struct samure_cairo_surface *c) {
+  const size_t index = c->swapchain.current;
+  c->buffer = c->swapchain.buffers[index];
+  c->cairo_surface = c->cairo_surfaces[index];
+  c->cairo = c->cairos[index];
+}
+
+void _samure_cairo_surface_destroy(struct samure_cairo_surface *c) {
+  for (size_t i = 0; i < c->swapchain.num_buffers; i++) {
+    _samure_cairo_surface_destroy_cairo(c, i);
+  }
+  samure_destroy_swapchain(&c->swapchain);
+  free(c);
+}
+
 void destroy(struct samure_context *ctx) {
   free(ctx->backend);
   ctx->backend = NULL;
 }
 
+void render_start(struct samure_context *ctx, struct samure_layer_surface *s) {
+  struct samure_cairo_surface *c =
+      (struct samure_cairo_surface *)s->backend_data;
+  if (!samure_swapchain_acquire(&c->swapchain)) {
+    s->no_buffer = 1;
+    return;
+  }
+
+  c->buffer_age = samure_swapchain_buffer_age(&c->swapchain);
+  _samure_cairo_surface_select_current(c);
+}
+
 void render_end(struct samure_context *ctx, struct samure_layer_surface *s) {
   struct samure_cairo_surface *c =
       (struct samure_cairo_surface *)s->backend_data;
-  samure_layer_surface_draw_buffer(s, c->buffer);
+  samure_swapchain_present(s, &c->swapchain);
 }
 
 samure_error associate_layer_surface(struct samure_context *ctx,
@@ -69,24 +113,27 @@ samure_error associate_layer_surface(struct samure_context *ctx,
   }
   memset(c, 0, sizeof(struct samure_cairo_surface));
 
-  SAMURE_RESULT(shared_buffer)
-  b_rs = samure_create_shared_buffer_for_layer_surface(ctx, sfc, c->buffer);
-  if (SAMURE_HAS_ERROR(b_rs)) {
-    free(c);
-    return SAMURE_ERROR_SHARED_BUFFER_INIT | b_rs.error;
-  }
+  c->swapchain = samure_init_swapchain(ctx);
 
-  c->buffer = SAMURE_UNWRAP(shared_buffer, b_rs);
+  samure_error err = samure_swapchain_resize(ctx, sfc, &c->swapchain);
+  if (SAMURE_IS_ERROR(err)) {
+    _samure_cairo_surface_destroy(c);
+    return err;
+  }
 
-  if (c->buffer->width != 0 && c->buffer->height != 0) {
-    const samure_error err = _samure_cairo_surface_create_cairo(c);
-    if (SAMURE_IS_ERROR(err)) {
-      samure_destroy_shared_buffer(c->buffer);
-      free(c);
-      return err;
+  for (size_t i = 0; i < c->swapchain.num_buffers; i++) {
+    if (c->swapchain.buffers[i]->width != 0 &&
+        c->swapchain.buffers[i]->height != 0) {
+      err = _samure_cairo_surface_create_cairo(c, i);
+      if (SAMURE_IS_ERROR(err)) {
+        _samure_cairo_surface_destroy(c);
+        return err;
+      }
     }
   }
 
+  _samure_cairo_surface_select_current(c);
+
   sfc->backend_data = c;
   render_end(ctx, sfc);
 
@@ -103,31 +150,38 @@ void on_layer_surface_configure(struct samure_context *ctx,
   struct samure_cairo_surface *c =
       (struct samure_cairo_surface *)layer_surface->backend_data;
 
-  SAMURE_RESULT(shared_buffer)
-  b_rs = samure_create_shared_buffer_for_layer_surface(ctx, layer_surface,
-                                                       c->buffer);
-  if (SAMURE_HAS_ERROR(b_rs)) {
-    c->buffer = NULL;
-  } else {
-    struct samure_shared_buffer *b = SAMURE_UNWRAP(shared_buffer, b_rs);
-    if (c->buffer != b) {
-      if (c->cairo) {
-        cairo_destroy(c->cairo);
-        c->cairo = NULL;
-      }
-      if (c->cairo_surface) {
-        cairo_surface_destroy(c->cairo_surface);
-        c->cairo_surface = NULL;
-      }
-      c->buffer = b;
+  // Destroy the cairo contexts of all buffers that need to be resized
+  uint32_t scaled_width =
+      GLOBAL_TO_LOCAL_SCALE(layer_surface, layer_surface->w);
+  uint32_t scaled_height =
+      GLOBAL_TO_LOCAL_SCALE(layer_surface, layer_surface->h);
+  scaled_width = scaled_width == 0 ? 1 : scaled_width;
+  scaled_height = scaled_height == 0 ? 1 : scaled_height;
+  for (size_t i = 0; i < c->swapchain.num_buffers; i++) {
+    struct samure_shared_buffer *b = c->swapchain.buffers[i];
+    if (!b || b->width != scaled_width || b->height != scaled_height) {
+      _samure_cairo_surface_destroy_cairo(c, i);
+    }
+  }
 
-      const samure_error err = _samure_cairo_surface_create_cairo(c);
+  const samure_error err =
+      samure_swapchain_resize(ctx, layer_surface, &c->swapchain);
+  if (SAMURE_IS_ERROR(err)) {
+    // The buffers that failed are skipped until the next configure
+    samure_perror("failed to resize swapchain", err);
+  }
+
+  for (size_t i = 0; i < c->swapchain.num_buffers; i++) {
+    if (c->swapchain.buffers[i] && !c->cairos[i]) {
+      const samure_error err = _samure_cairo_surface_create_cairo(c, i);
       if (SAMURE_IS_ERROR(err)) {
-        samure_destroy_shared_buffer(c->buffer);
-        c->buffer = NULL;
+        samure_destroy_shared_buffer(c->swapchain.buffers[i]);
+        c->swapchain.buffers[i] = NULL;
       }
     }
   }
+
+  _samure_cairo_surface_select_current(c);
 }
 
 void unassociate_layer_surface(struct samure_context *ctx,
@@ -139,12 +193,6 @@ void unassociate_layer_surface(struct samure_context *ctx,
   struct samure_cairo_surface *c =
       (struct samure_cairo_surface *)layer_surface->backend_data;
 
-  if (c->cairo)
-    cairo_destroy(c->cairo);
-  if (c->cairo_surface)
-    cairo_surface_destroy(c->cairo_surface);
-  if (c->buffer)
-    samure_destroy_shared_buffer(c->buffer);
-  free(c);
+  _samure_cairo_surface_destroy(c);
   layer_surface->backend_data = NULL;
 }
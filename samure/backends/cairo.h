@@ -30,14 +30,23 @@
 
 #include "../backend.h"
 #include "../error_handling.h"
+#include "../swapchain.h"
 
 struct samure_shared_buffer;
 
 // public
 struct samure_cairo_surface {
+  // The buffer, cairo surface and cairo context to render into
   struct samure_shared_buffer *buffer;
   cairo_surface_t *cairo_surface;
   cairo_t *cairo;
+  // How many frames old the contents of buffer are. 0 means undefined
+  // contents (see samure_layer_surface_get_buffer_damage)
+  uint64_t buffer_age;
+
+  struct samure_swapchain swapchain;
+  cairo_surface_t *cairo_surfaces[SAMURE_MAX_SWAPCHAIN_BUFFERS];
+  cairo_t *cairos[SAMURE_MAX_SWAPCHAIN_BUFFERS];
 };
 
 // public
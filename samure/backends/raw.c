@@ -26,17 +26,30 @@
 
 #include "raw.h"
 #include "../context.h"
+#include "../pixel_format.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
 SAMURE_DEFINE_RESULT_UNWRAP(backend_raw);
 
+void samure_backend_raw_render_start(
+    struct samure_context *ctx, struct samure_layer_surface *layer_surface) {
+  struct samure_raw_surface *r =
+      (struct samure_raw_surface *)layer_surface->backend_data;
+  r->buffer = samure_swapchain_acquire(&r->swapchain);
+  if (!r->buffer) {
+    layer_surface->no_buffer = 1;
+    return;
+  }
+  r->buffer_age = samure_swapchain_buffer_age(&r->swapchain);
+}
+
 void samure_backend_raw_render_end(struct samure_context *ctx,
                                    struct samure_layer_surface *layer_surface) {
   struct samure_raw_surface *r =
       (struct samure_raw_surface *)layer_surface->backend_data;
-  samure_layer_surface_draw_buffer(layer_surface, r->buffer);
+  samure_swapchain_present(layer_surface, &r->swapchain);
 }
 
 samure_error
@@ -48,14 +61,16 @@ samure_backend_raw_associate_layer_surface(struct samure_context *ctx,
   }
   memset(r, 0, sizeof(struct samure_raw_surface));
 
-  SAMURE_RESULT(shared_buffer)
-  b_rs = samure_create_shared_buffer_for_layer_surface(ctx, sfc, r->buffer);
-  if (SAMURE_HAS_ERROR(b_rs)) {
+  r->swapchain = samure_init_swapchain(ctx);
+
+  const samure_error err = samure_swapchain_resize(ctx, sfc, &r->swapchain);
+  if (SAMURE_IS_ERROR(err)) {
+    samure_destroy_swapchain(&r->swapchain);
     free(r);
-    return SAMURE_ERROR_SHARED_BUFFER_INIT | b_rs.error;
+    return err;
   }
 
-  r->buffer = SAMURE_UNWRAP(shared_buffer, b_rs);
+  r->buffer = r->swapchain.buffers[r->swapchain.current];
 
   sfc->backend_data = r;
   samure_backend_raw_render_end(ctx, sfc);
@@ -73,14 +88,13 @@ void samure_backend_raw_on_layer_surface_configure(
   struct samure_raw_surface *r =
       (struct samure_raw_surface *)layer_surface->backend_data;
 
-  SAMURE_RESULT(shared_buffer)
-  b_rs = samure_create_shared_buffer_for_layer_surface(ctx, layer_surface,
-                                                       r->buffer);
-  if (SAMURE_HAS_ERROR(b_rs)) {
-    r->buffer = NULL;
-  } else {
-    r->buffer = SAMURE_UNWRAP(shared_buffer, b_rs);
+  const samure_error err =
+      samure_swapchain_resize(ctx, layer_surface, &r->swapchain);
+  if (SAMURE_IS_ERROR(err)) {
+    // The buffers that failed are skipped until the next configure
+    samure_perror("failed to resize swapchain", err);
   }
+  r->buffer = r->swapchain.buffers[r->swapchain.current];
 }
 
 void samure_backend_raw_unassociate_layer_surface(
@@ -91,7 +105,8 @@ void samure_backend_raw_unassociate_layer_surface(
 
   struct samure_raw_surface *r = (struct samure_raw_surface *)sfc->backend_data;
 
-  samure_destroy_shared_buffer(r->buffer);
+  samure_destroy_swapchain(&r->swapchain);
+  free(r->tiles);
   free(r);
   sfc->backend_data = NULL;
 }
@@ -100,6 +115,7 @@ SAMURE_RESULT(backend_raw)
 samure_init_backend_raw(struct samure_context *ctx) {
   SAMURE_RESULT_ALLOC(backend_raw, r);
 
+  r->base.render_start = samure_backend_raw_render_start;
   r->base.render_end = samure_backend_raw_render_end;
   r->base.destroy = samure_destroy_backend_raw;
   r->base.associate_layer_surface = samure_backend_raw_associate_layer_surface;
@@ -107,6 +123,7 @@ samure_init_backend_raw(struct samure_context *ctx) {
       samure_backend_raw_on_layer_surface_configure;
   r->base.unassociate_layer_surface =
       samure_backend_raw_unassociate_layer_surface;
+  r->base.thread_safe_rendering = 1;
 
   SAMURE_RETURN_RESULT(backend_raw, r);
 }
@@ -120,3 +137,111 @@ struct samure_raw_surface *
 samure_get_raw_surface(struct samure_layer_surface *layer_surface) {
   return (struct samure_raw_surface *)layer_surface->backend_data;
 }
+
+struct samure_raw_tile_job {
+  struct samure_context *ctx;
+  struct samure_layer_surface *sfc;
+  struct samure_raw_surface *r;
+  size_t num_tiles_x;
+  int32_t bytes_per_pixel;
+  samure_raw_tile_callback tile_callback;
+  void *user_data;
+};
+
+static void samure_raw_render_tile(void *data, size_t index) {
+  struct samure_raw_tile_job *j = (struct samure_raw_tile_job *)data;
+  struct samure_shared_buffer *b = j->r->buffer;
+
+  const uint32_t tile_index = j->r->tiles[index];
+  const struct samure_rect buffer_rect = {0, 0, b->width, b->height};
+  const struct samure_rect tile_rect = {
+      .x = (int32_t)(tile_index % j->num_tiles_x) * SAMURE_RAW_TILE_SIZE,
+      .y = (int32_t)(tile_index / j->num_tiles_x) * SAMURE_RAW_TILE_SIZE,
+      .w = SAMURE_RAW_TILE_SIZE,
+      .h = SAMURE_RAW_TILE_SIZE,
+  };
+
+  struct samure_raw_tile tile;
+  tile.rect = samure_rect_intersection(tile_rect, buffer_rect);
+  tile.data = (uint8_t *)b->data + (size_t)tile.rect.y * (size_t)b->stride +
+              (size_t)tile.rect.x * (size_t)j->bytes_per_pixel;
+  tile.stride = b->stride;
+
+  j->tile_callback(j->ctx, j->sfc, tile, j->user_data);
+}
+
+// Returns whether the tile needs to be redrawn
+static int samure_raw_tile_damaged(struct samure_rect tile,
+                                   struct samure_layer_surface *sfc,
+                                   struct samure_rect age_damage) {
+  if (samure_rect_intersection(tile, age_damage).w != 0) {
+    return 1;
+  }
+  for (size_t i = 0; i < sfc->num_damage; i++) {
+    if (samure_rect_intersection(tile, sfc->damage[i]).w != 0) {
+      return 1;
+    }
+  }
+  return 0;
+}
+
+void samure_raw_surface_render_tiles(struct samure_context *ctx,
+                                     struct samure_layer_surface *sfc,
+                                     samure_raw_tile_callback tile_callback,
+                                     void *user_data) {
+  struct samure_raw_surface *r = samure_get_raw_surface(sfc);
+  if (!r || !r->buffer || r->buffer->width <= 0 || r->buffer->height <= 0) {
+    return;
+  }
+  struct samure_shared_buffer *b = r->buffer;
+
+  const size_t num_tiles_x =
+      ((size_t)b->width + SAMURE_RAW_TILE_SIZE - 1) / SAMURE_RAW_TILE_SIZE;
+  const size_t num_tiles_y =
+      ((size_t)b->height + SAMURE_RAW_TILE_SIZE - 1) / SAMURE_RAW_TILE_SIZE;
+  const size_t max_tiles = num_tiles_x * num_tiles_y;
+
+  if (r->cap_tiles < max_tiles) {
+    uint32_t *tiles = realloc(r->tiles, max_tiles * sizeof(uint32_t));
+    if (!tiles) {
+      return;
+    }
+    r->tiles = tiles;
+    r->cap_tiles = max_tiles;
+  }
+
+  // Without reported damage the whole buffer gets submitted
+  const struct samure_rect age_damage =
+      sfc->num_damage == 0
+          ? (struct samure_rect){0, 0, b->width, b->height}
+          : samure_layer_surface_get_buffer_damage(sfc, r->buffer_age);
+
+  size_t num_tiles = 0;
+  for (size_t i = 0; i < max_tiles; i++) {
+    const struct samure_rect tile = {
+        .x = (int32_t)(i % num_tiles_x) * SAMURE_RAW_TILE_SIZE,
+        .y = (int32_t)(i / num_tiles_x) * SAMURE_RAW_TILE_SIZE,
+        .w = SAMURE_RAW_TILE_SIZE,
+        .h = SAMURE_RAW_TILE_SIZE,
+    };
+    if (samure_raw_tile_damaged(tile, sfc, age_damage)) {
+      r->tiles[num_tiles] = (uint32_t)i;
+      num_tiles++;
+    }
+  }
+
+  struct samure_raw_tile_job j = {
+      .ctx = ctx,
+      .sfc = sfc,
+      .r = r,
+      .num_tiles_x = num_tiles_x,
+      .bytes_per_pixel = samure_format_bytes_per_pixel(b->format),
+      .tile_callback = tile_callback,
+      .user_data = user_data,
+  };
+
+  // The worker pool is already busy if the layer surfaces are rendered in
+  // parallel
+  samure_worker_pool_run(ctx->rendering_in_parallel ? NULL : ctx->worker_pool,
+                         num_tiles, samure_raw_render_tile, &j);
+}
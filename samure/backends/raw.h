@@ -28,14 +28,40 @@
 
 #include "../backend.h"
 #include "../error_handling.h"
+#include "../rect.h"
+#include "../swapchain.h"
+
+// Width and height of the tiles of samure_raw_surface_render_tiles
+#define SAMURE_RAW_TILE_SIZE 128
 
 struct samure_context;
 struct samure_layer_surface;
 struct samure_shared_buffer;
 
+// public
+// A part of the buffer of a raw surface
+struct samure_raw_tile {
+  struct samure_rect rect; // Region of the tile in buffer coordinates
+  void *data;              // The first pixel of the tile
+  int32_t stride;          // Size of one row of the buffer in bytes
+};
+
+// public
+typedef void (*samure_raw_tile_callback)(struct samure_context *ctx,
+                                         struct samure_layer_surface *sfc,
+                                         struct samure_raw_tile tile,
+                                         void *user_data);
+
 // public
 struct samure_raw_surface {
-  struct samure_shared_buffer *buffer;
+  struct samure_shared_buffer *buffer; // The buffer to render into
+  // How many frames old the contents of buffer are. 0 means undefined
+  // contents (see samure_layer_surface_get_buffer_damage)
+  uint64_t buffer_age;
+  struct samure_swapchain swapchain;
+
+  uint32_t *tiles; // Indices of the tiles that are rendered
+  size_t cap_tiles;
 };
 
 struct samure_backend_raw {
@@ -52,3 +78,14 @@ extern void samure_destroy_backend_raw(struct samure_context *ctx);
 // public
 extern struct samure_raw_surface *
 samure_get_raw_surface(struct samure_layer_surface *layer_surface);
+// public
+// Splits the buffer of the raw surface into tiles of SAMURE_RAW_TILE_SIZE and
+// calls tile_callback for every tile that needs to be redrawn on the worker
+// pool of the context. Those are the tiles touched by the damage reported for
+// the current frame and by the damage that the buffer is missing because of
+// its age. If no damage has been reported all tiles are redrawn. Call it from
+// the render callback after reporting the damage. tile_callback must be thread
+// safe
+extern void samure_raw_surface_render_tiles(
+    struct samure_context *ctx, struct samure_layer_surface *sfc,
+    samure_raw_tile_callback tile_callback, void *user_data);
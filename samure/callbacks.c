@@ -33,46 +33,107 @@
 #include "error_handling.h"
 
 #define NEW_EVENT()                                                            \
-  ctx->num_events++;                                                           \
-  if (ctx->num_events > ctx->cap_events) {                                     \
-    ctx->cap_events = ctx->num_events;                                         \
-    ctx->events =                                                              \
-        realloc(ctx->events, ctx->cap_events * sizeof(struct samure_event));   \
-    if (!ctx->events) {                                                        \
-      ctx->cap_events = 0;                                                     \
-      ctx->num_events = 0;                                                     \
-      return;                                                                  \
-    }                                                                          \
+  if (!samure_context_new_event(ctx)) {                                        \
+    return;                                                                    \
   }
 
 #define LAST_EVENT ctx->events[ctx->num_events - 1]
 
-#define OUTPUT_FOR_SURFACE()                                                   \
-  struct samure_output *output = NULL;                                         \
-  struct samure_layer_surface *layer_surface = NULL;                           \
-  for (size_t i = 0; i < ctx->num_outputs; i++) {                              \
-    for (size_t j = 0; j < ctx->outputs[i]->num_sfc; j++) {                    \
-      if (ctx->outputs[i]->sfc[j]->surface == surface) {                       \
-        output = ctx->outputs[i];                                              \
-        layer_surface = ctx->outputs[i]->sfc[j];                               \
-        break;                                                                 \
-      }                                                                        \
-    }                                                                          \
+// Stores the motion event at event_index in the motion history
+static void samure_store_motion_sample(struct samure_context *ctx,
+                                       size_t event_index, double x, double y,
+                                       uint32_t time) {
+  if (ctx->num_motion_samples == ctx->cap_motion_samples) {
+    const size_t cap_motion_samples =
+        ctx->cap_motion_samples == 0 ? SAMURE_NUM_PREALLOCATED_EVENTS
+                                     : ctx->cap_motion_samples * 2;
+    struct samure_event_motion_sample *motion_samples =
+        realloc(ctx->motion_samples,
+                cap_motion_samples * sizeof(struct samure_event_motion_sample));
+    if (!motion_samples) {
+      return;
+    }
+    ctx->motion_samples = motion_samples;
+    ctx->cap_motion_samples = cap_motion_samples;
   }
 
-#define OUTPUT_FOR_LAYER_SURFACE()                                             \
-  struct samure_output *output = NULL;                                         \
-  struct samure_layer_surface *layer_surface = NULL;                           \
-  for (size_t i = 0; i < ctx->num_outputs; i++) {                              \
-    for (size_t j = 0; j < ctx->outputs[i]->num_sfc; j++) {                    \
-      if (ctx->outputs[i]->sfc[j]->layer_surface == surface) {                 \
-        output = ctx->outputs[i];                                              \
-        layer_surface = ctx->outputs[i]->sfc[j];                               \
-        break;                                                                 \
-      }                                                                        \
-    }                                                                          \
+  struct samure_event_motion_sample *s =
+      &ctx->motion_samples[ctx->num_motion_samples];
+  s->event_index = event_index;
+  s->sample.x = x;
+  s->sample.y = y;
+  s->sample.time = time;
+  ctx->num_motion_samples++;
+}
+
+// Merges a motion event into the latest queued motion event of the same seat
+// and touch point. Returns 1 if it has been merged. Stops at any other event
+// of the seat so that the order of events is preserved. Frame events are
+// skipped since the frame of the new motion event gets merged as well
+static int samure_coalesce_motion_event(struct samure_context *ctx, int type,
+                                        struct samure_seat *seat,
+                                        int32_t touch_id, double x, double y,
+                                        uint32_t time) {
+  if (!ctx->config.coalesce_motion_events) {
+    return 0;
+  }
+
+  for (size_t i = ctx->num_events; i > ctx->event_index; i--) {
+    struct samure_event *e = &ctx->events[i - 1];
+    if (e->seat != seat || e->type == SAMURE_EVENT_POINTER_FRAME ||
+        e->type == SAMURE_EVENT_TOUCH_FRAME) {
+      continue;
+    }
+    if (e->type != type) {
+      return 0;
+    }
+    if (e->touch_id != touch_id) {
+      continue;
+    }
+
+    e->x = x;
+    e->y = y;
+    e->num_samples++;
+    if (ctx->config.keep_motion_history) {
+      samure_store_motion_sample(ctx, i - 1, x, y, time);
+    }
+    return 1;
+  }
+
+  return 0;
+}
+
+// Appends a POINTER_FRAME or TOUCH_FRAME event unless the latest queued event
+// of the seat already is one, which happens if all events of the frame have
+// been coalesced
+static void samure_push_frame_event(struct samure_context *ctx, int type,
+                                    struct samure_seat *seat) {
+  for (size_t i = ctx->num_events; i > ctx->event_index; i--) {
+    const struct samure_event *e = &ctx->events[i - 1];
+    if (e->seat == seat) {
+      if (e->type == type) {
+        return;
+      }
+      break;
+    }
   }
 
+  NEW_EVENT();
+
+  LAST_EVENT.type = type;
+  LAST_EVENT.seat = seat;
+}
+
+#define OUTPUT_FOR_SURFACE()                                                   \
+  struct samure_layer_surface *layer_surface =                                 \
+      samure_layer_surface_from_surface(surface);                              \
+  struct samure_output *output = layer_surface ? layer_surface->output : NULL
+
+#define OUTPUT_FOR_LAYER_SURFACE()                                             \
+  struct samure_layer_surface *layer_surface =                                 \
+      (struct samure_layer_surface *)d->data;                                  \
+  struct samure_output *output = layer_surface->output
+
 #define OUTPUT_FOR_OUTPUT()                                                    \
   struct samure_output *output = NULL;                                         \
   for (size_t i = 0; i < ctx->num_outputs; i++) {                              \
@@ -92,16 +153,33 @@
   const uint32_t ver = v
 
 #define ASSERT_MIN_MAX_VERSION(min_v, max_v)                                   \
-  uint32_t ver;                                                                \
-  if (version >= max_v) {                                                      \
-    ver = max_v;                                                               \
-  } else if (version < min_v) {                                                \
+  if (version < min_v) {                                                       \
     fprintf(stderr, "\033[31m%s\033[0m: version %u < %u < %u\n", interface,    \
             version, min_v, max_v);                                            \
     reg_d->error |= SAMURE_ERROR_PROTOCOL_VERSION;                             \
     return;                                                                    \
   }                                                                            \
-  ver = min_v
+  const uint32_t ver = version > max_v ? max_v : version
+
+// Binds a wl_output global and creates its output right away so that none of
+// its events get lost
+static struct samure_output *samure_bind_output(struct samure_context *ctx,
+                                                struct wl_registry *registry,
+                                                uint32_t name,
+                                                uint32_t version) {
+  struct wl_output *output =
+      wl_registry_bind(registry, name, &wl_output_interface, version);
+
+  SAMURE_RESULT(output) o_rs = samure_create_output(ctx, output);
+  if (SAMURE_HAS_ERROR(o_rs)) {
+    wl_output_destroy(output);
+    return NULL;
+  }
+
+  struct samure_output *o = SAMURE_UNWRAP(output, o_rs);
+  o->registry_name = name;
+  return o;
+}
 
 void registry_global(void *data, struct wl_registry *registry, uint32_t name,
                      const char *interface, uint32_t version) {
@@ -113,12 +191,23 @@ void registry_global(void *data, struct wl_registry *registry, uint32_t name,
   struct samure_context *ctx = d->ctx;
   struct samure_registry_data *reg_d = (struct samure_registry_data *)d->data;
 
+  if (!reg_d) {
+    // The context has already been created, only outputs are added later on
+    if (strcmp(interface, wl_output_interface.name) == 0 && version >= 3) {
+      struct samure_output *o = samure_bind_output(ctx, registry, name, 3);
+      if (o) {
+        samure_context_add_pending_output(ctx, o);
+      }
+    }
+    return;
+  }
+
   if (strcmp(interface, wl_shm_interface.name) == 0) {
     ASSERT_VERSION(1);
 
     ctx->shm = wl_registry_bind(registry, name, &wl_shm_interface, ver);
   } else if (strcmp(interface, wl_seat_interface.name) == 0) {
-    ASSERT_VERSION(1);
+    ASSERT_MIN_MAX_VERSION(1, 5);
 
     struct wl_seat *seat =
         wl_registry_bind(registry, name, &wl_seat_interface, ver);
@@ -144,17 +233,21 @@ void registry_global(void *data, struct wl_registry *registry, uint32_t name,
   } else if (strcmp(interface, wl_output_interface.name) == 0) {
     ASSERT_VERSION(3);
 
-    struct wl_output *output =
-        wl_registry_bind(registry, name, &wl_output_interface, ver);
+    struct samure_output *o = samure_bind_output(ctx, registry, name, ver);
+    if (!o) {
+      reg_d->error |= SAMURE_ERROR_OUTPUT_INIT;
+      return;
+    }
 
     reg_d->num_outputs++;
-    reg_d->outputs = realloc(reg_d->outputs,
-                             reg_d->num_outputs * sizeof(struct wl_output *));
+    reg_d->outputs =
+        realloc(reg_d->outputs,
+                reg_d->num_outputs * sizeof(struct samure_output *));
     if (!reg_d->outputs) {
       reg_d->num_outputs = 0;
       return;
     }
-    reg_d->outputs[reg_d->num_outputs - 1] = output;
+    reg_d->outputs[reg_d->num_outputs - 1] = o;
   } else if (strcmp(interface, zxdg_output_manager_v1_interface.name) == 0) {
     ASSERT_VERSION(2);
 
@@ -183,11 +276,23 @@ void registry_global(void *data, struct wl_registry *registry, uint32_t name,
 
     ctx->viewporter =
         wl_registry_bind(registry, name, &wp_viewporter_interface, ver);
+  } else if (strcmp(interface, wp_presentation_interface.name) == 0) {
+    ASSERT_VERSION(1);
+
+    ctx->presentation =
+        wl_registry_bind(registry, name, &wp_presentation_interface, ver);
+    wp_presentation_add_listener(ctx->presentation, &presentation_listener,
+                                 ctx);
   }
 }
 
 void registry_global_remove(void *data, struct wl_registry *registry,
-                            uint32_t name) {}
+                            uint32_t name) {
+  DEBUG_PRINTF("\033[34mregistry_global_remove\033[0m name=%u\n", name);
+
+  struct samure_callback_data *d = (struct samure_callback_data *)data;
+  samure_context_remove_output(d->ctx, name);
+}
 
 void seat_capabilities(void *data, struct wl_seat *seat,
                        uint32_t capabilities) {
@@ -195,20 +300,25 @@ void seat_capabilities(void *data, struct wl_seat *seat,
   struct samure_context *ctx = d->ctx;
   struct samure_seat *s = (struct samure_seat *)d->data;
 
-  if (capabilities & WL_SEAT_CAPABILITY_POINTER) {
+  if ((capabilities & WL_SEAT_CAPABILITY_POINTER) && !s->pointer) {
     s->pointer = wl_seat_get_pointer(seat);
+    wl_pointer_add_listener(s->pointer, &pointer_listener, d);
   }
-  if (capabilities & WL_SEAT_CAPABILITY_KEYBOARD) {
+  if ((capabilities & WL_SEAT_CAPABILITY_KEYBOARD) && !s->keyboard) {
     s->keyboard = wl_seat_get_keyboard(seat);
+    wl_keyboard_add_listener(s->keyboard, &keyboard_listener, d);
   }
-  if (capabilities & WL_SEAT_CAPABILITY_TOUCH) {
+  if ((capabilities & WL_SEAT_CAPABILITY_TOUCH) && !s->touch) {
     s->touch = wl_seat_get_touch(seat);
+    wl_touch_add_listener(s->touch, &touch_listener, d);
   }
 }
 
 void seat_name(void *data, struct wl_seat *wl_seat, const char *name) {
-  struct samure_seat *s = (struct samure_seat *)data;
+  struct samure_callback_data *d = (struct samure_callback_data *)data;
+  struct samure_seat *s = (struct samure_seat *)d->data;
 
+  free(s->name);
   s->name = strdup(name);
 }
 
@@ -267,13 +377,25 @@ void pointer_motion(void *data, struct wl_pointer *pointer, uint32_t time,
   struct samure_callback_data *d = (struct samure_callback_data *)data;
   struct samure_context *ctx = d->ctx;
   struct samure_seat *seat = d->data;
+  const double x = wl_fixed_to_double(surface_x);
+  const double y = wl_fixed_to_double(surface_y);
+
+  if (samure_coalesce_motion_event(ctx, SAMURE_EVENT_POINTER_MOTION, seat, 0, x,
+                                   y, time)) {
+    return;
+  }
 
   NEW_EVENT();
 
   LAST_EVENT.type = SAMURE_EVENT_POINTER_MOTION;
   LAST_EVENT.seat = seat;
-  LAST_EVENT.x = wl_fixed_to_double(surface_x);
-  LAST_EVENT.y = wl_fixed_to_double(surface_y);
+  LAST_EVENT.x = x;
+  LAST_EVENT.y = y;
+  LAST_EVENT.num_samples = 1;
+
+  if (ctx->config.keep_motion_history) {
+    samure_store_motion_sample(ctx, ctx->num_events - 1, x, y, time);
+  }
 }
 
 void pointer_button(void *data, struct wl_pointer *pointer, uint32_t serial,
@@ -293,6 +415,23 @@ void pointer_button(void *data, struct wl_pointer *pointer, uint32_t serial,
 void pointer_axis(void *data, struct wl_pointer *wl_pointer, uint32_t time,
                   uint32_t axis, wl_fixed_t value) {}
 
+void pointer_frame(void *data, struct wl_pointer *wl_pointer) {
+  struct samure_callback_data *d = (struct samure_callback_data *)data;
+  struct samure_context *ctx = d->ctx;
+  struct samure_seat *seat = (struct samure_seat *)d->data;
+
+  samure_push_frame_event(ctx, SAMURE_EVENT_POINTER_FRAME, seat);
+}
+
+void pointer_axis_source(void *data, struct wl_pointer *wl_pointer,
+                         uint32_t axis_source) {}
+
+void pointer_axis_stop(void *data, struct wl_pointer *wl_pointer,
+                       uint32_t time, uint32_t axis) {}
+
+void pointer_axis_discrete(void *data, struct wl_pointer *wl_pointer,
+                           uint32_t axis, int32_t discrete) {}
+
 void surface_enter(void *data, struct wl_surface *surface,
                    struct wl_output *output) {}
 
@@ -376,6 +515,9 @@ void output_geometry(void *data, struct wl_output *wl_output, int32_t x,
 void output_done(void *data, struct wl_output *wl_output) {
   struct samure_output *o = (struct samure_output *)data;
   DEBUG_PRINTF("output_done output=%s\n", o->name);
+  if (!o->xdg_output) {
+    o->done = 1;
+  }
 }
 
 void output_scale(void *data, struct wl_output *wl_output, int32_t factor) {
@@ -405,6 +547,8 @@ void output_mode(void *data, struct wl_output *wl_output, uint32_t flags,
     return;
   }
 
+  o->refresh_rate = refresh;
+
   // Only retrieve geometry from "normal" output if no xdg output could be
   // created
   if (!o->xdg_output) {
@@ -438,12 +582,14 @@ void xdg_output_done(void *data, struct zxdg_output_v1 *zxdg_output_v1) {
   struct samure_output *o = data;
   DEBUG_PRINTF("\033[34mxdg_output_done\033[0m output=%s\n",
                o->name ? o->name : "null");
+  o->done = 1;
 }
 
 void xdg_output_name(void *data, struct zxdg_output_v1 *zxdg_output_v1,
                      const char *name) {
   DEBUG_PRINTF("\033[34mxdg_output_name\033[0m name=%s\n", name);
   struct samure_output *o = data;
+  free(o->name);
   o->name = strdup(name);
 }
 
@@ -524,8 +670,14 @@ void screencopy_frame_buffer(
 
   struct samure_screenshot_data *d = (struct samure_screenshot_data *)data;
 
-  d->buffer_rs =
-      samure_create_shared_buffer(d->ctx->shm, format, width, height);
+  // The compositor decides about the stride, which might include padding
+  if (d->ctx->shm_arena) {
+    d->buffer_rs = samure_shm_arena_create_buffer_with_stride(
+        d->ctx->shm_arena, format, width, height, stride);
+  } else {
+    d->buffer_rs = samure_create_shared_buffer_with_stride(
+        d->ctx->shm, format, width, height, stride);
+  }
 }
 
 void screencopy_frame_flags(
@@ -544,6 +696,9 @@ void screencopy_frame_ready(
                tv_sec_hi, tv_sec_lo, tv_sec, tv_nsec);
   struct samure_screenshot_data *d = (struct samure_screenshot_data *)data;
   d->state = SAMURE_SCREENSHOT_READY;
+  if (d->async) {
+    samure_screenshot_finish((struct samure_screenshot *)d);
+  }
 }
 
 void screencopy_frame_failed(
@@ -551,6 +706,9 @@ void screencopy_frame_failed(
   DEBUG_PRINT("\033[34mscreencopy_frame_failed\033[0m\n");
   struct samure_screenshot_data *d = (struct samure_screenshot_data *)data;
   d->state = SAMURE_SCREENSHOT_FAILED;
+  if (d->async) {
+    samure_screenshot_finish((struct samure_screenshot *)d);
+  }
 }
 
 void screencopy_frame_damage(
@@ -574,6 +732,67 @@ void screencopy_frame_buffer_done(
   DEBUG_PRINT("\033[34mscreencopy_frame_done\033[0m\n");
   struct samure_screenshot_data *d = (struct samure_screenshot_data *)data;
   d->state = SAMURE_SCREENSHOT_DONE;
+  if (d->async) {
+    samure_screenshot_copy((struct samure_screenshot *)d);
+  }
+}
+
+void screencopy_stream_buffer(
+    void *data, struct zwlr_screencopy_frame_v1 *zwlr_screencopy_frame_v1,
+    uint32_t format, uint32_t width, uint32_t height, uint32_t stride) {
+  DEBUG_PRINTF("\033[34mscreencopy_stream_buffer\033[0m format=%u width=%u "
+               "height=%u stride=%u\n",
+               format, width, height, stride);
+  struct samure_screencopy_stream *s = (struct samure_screencopy_stream *)data;
+  samure_screencopy_stream_buffer(s, format, width, height, stride);
+}
+
+void screencopy_stream_flags(
+    void *data, struct zwlr_screencopy_frame_v1 *zwlr_screencopy_frame_v1,
+    uint32_t flags) {
+  DEBUG_PRINTF("\033[34mscreencopy_stream_flags\033[0m flags=%u\n", flags);
+  struct samure_screencopy_stream *s = (struct samure_screencopy_stream *)data;
+  s->frames[s->frame_index].flags = flags;
+}
+
+void screencopy_stream_ready(
+    void *data, struct zwlr_screencopy_frame_v1 *zwlr_screencopy_frame_v1,
+    uint32_t tv_sec_hi, uint32_t tv_sec_lo, uint32_t tv_nsec) {
+  const uint64_t tv_sec = (((uint64_t)tv_sec_hi) << 32) + (uint64_t)tv_sec_lo;
+  DEBUG_PRINTF("\033[34mscreencopy_stream_ready\033[0m tv_sec=%lu "
+               "tv_nsec=%u\n",
+               tv_sec, tv_nsec);
+  struct samure_screencopy_stream *s = (struct samure_screencopy_stream *)data;
+  samure_screencopy_stream_ready(s, (double)tv_sec + (double)tv_nsec / 1e9);
+}
+
+void screencopy_stream_failed(
+    void *data, struct zwlr_screencopy_frame_v1 *zwlr_screencopy_frame_v1) {
+  DEBUG_PRINT("\033[34mscreencopy_stream_failed\033[0m\n");
+  struct samure_screencopy_stream *s = (struct samure_screencopy_stream *)data;
+  samure_screencopy_stream_failed(s, SAMURE_ERROR_FAILED);
+}
+
+void screencopy_stream_damage(
+    void *data, struct zwlr_screencopy_frame_v1 *zwlr_screencopy_frame_v1,
+    uint32_t x, uint32_t y, uint32_t width, uint32_t height) {
+  DEBUG_PRINTF(
+      "\033[34mscreencopy_stream_damage\033[0m x=%u y=%u width=%u height=%u\n",
+      x, y, width, height);
+  struct samure_screencopy_stream *s = (struct samure_screencopy_stream *)data;
+  samure_screencopy_stream_damage(s, (struct samure_rect){
+                                         .x = x,
+                                         .y = y,
+                                         .w = width,
+                                         .h = height,
+                                     });
+}
+
+void screencopy_stream_buffer_done(
+    void *data, struct zwlr_screencopy_frame_v1 *zwlr_screencopy_frame_v1) {
+  DEBUG_PRINT("\033[34mscreencopy_stream_buffer_done\033[0m\n");
+  struct samure_screencopy_stream *s = (struct samure_screencopy_stream *)data;
+  samure_screencopy_stream_copy(s);
 }
 
 void touch_down(void *data, struct wl_touch *wl_touch, uint32_t serial,
@@ -619,17 +838,35 @@ void touch_motion(void *data, struct wl_touch *wl_touch, uint32_t time,
   struct samure_callback_data *d = (struct samure_callback_data *)data;
   struct samure_context *ctx = d->ctx;
   struct samure_seat *seat = (struct samure_seat *)d->data;
+  const double dx = wl_fixed_to_double(x);
+  const double dy = wl_fixed_to_double(y);
+
+  if (samure_coalesce_motion_event(ctx, SAMURE_EVENT_TOUCH_MOTION, seat, id, dx,
+                                   dy, time)) {
+    return;
+  }
 
   NEW_EVENT();
 
-  LAST_EVENT.type = SAMURE_EVENT_TOUCH_UP;
+  LAST_EVENT.type = SAMURE_EVENT_TOUCH_MOTION;
   LAST_EVENT.seat = seat;
-  LAST_EVENT.x = wl_fixed_to_double(x);
-  LAST_EVENT.y = wl_fixed_to_double(y);
+  LAST_EVENT.x = dx;
+  LAST_EVENT.y = dy;
   LAST_EVENT.touch_id = id;
+  LAST_EVENT.num_samples = 1;
+
+  if (ctx->config.keep_motion_history) {
+    samure_store_motion_sample(ctx, ctx->num_events - 1, dx, dy, time);
+  }
 }
 
-void touch_frame(void *data, struct wl_touch *wl_touch) {}
+void touch_frame(void *data, struct wl_touch *wl_touch) {
+  struct samure_callback_data *d = (struct samure_callback_data *)data;
+  struct samure_context *ctx = d->ctx;
+  struct samure_seat *seat = (struct samure_seat *)d->data;
+
+  samure_push_frame_event(ctx, SAMURE_EVENT_TOUCH_FRAME, seat);
+}
 
 void touch_cancel(void *data, struct wl_touch *wl_touch) {}
 
@@ -648,6 +885,7 @@ void frame_done(void *data, struct wl_callback *wl_callback,
   free(d);
 
   wl_callback_destroy(wl_callback);
+  sfc->frame_callback = NULL;
   sfc->not_ready = 0;
 
   if (sfc->dirty) {
@@ -655,13 +893,59 @@ void frame_done(void *data, struct wl_callback *wl_callback,
   }
 }
 
+void presentation_clock_id(void *data, struct wp_presentation *wp_presentation,
+                           uint32_t clk_id) {
+  DEBUG_PRINTF("\033[34mpresentation_clock_id\033[0m clk_id=%u\n", clk_id);
+
+  struct samure_context *ctx = (struct samure_context *)data;
+  ctx->presentation_clock_id = clk_id;
+}
+
+void presentation_feedback_sync_output(
+    void *data, struct wp_presentation_feedback *wp_presentation_feedback,
+    struct wl_output *output) {}
+
+void presentation_feedback_presented(
+    void *data, struct wp_presentation_feedback *wp_presentation_feedback,
+    uint32_t tv_sec_hi, uint32_t tv_sec_lo, uint32_t tv_nsec, uint32_t refresh,
+    uint32_t seq_hi, uint32_t seq_lo, uint32_t flags) {
+  struct samure_layer_surface *sfc = (struct samure_layer_surface *)data;
+
+  const uint64_t tv_sec = (((uint64_t)tv_sec_hi) << 32) + (uint64_t)tv_sec_lo;
+  const uint64_t seq = (((uint64_t)seq_hi) << 32) + (uint64_t)seq_lo;
+
+  samure_layer_surface_finish_presentation_feedback(
+      sfc, wp_presentation_feedback, 1,
+      (double)tv_sec + (double)tv_nsec / (1000.0 * 1000.0 * 1000.0),
+      (double)refresh / (1000.0 * 1000.0 * 1000.0), seq, flags);
+  wp_presentation_feedback_destroy(wp_presentation_feedback);
+}
+
+void presentation_feedback_discarded(
+    void *data, struct wp_presentation_feedback *wp_presentation_feedback) {
+  struct samure_layer_surface *sfc = (struct samure_layer_surface *)data;
+
+  samure_layer_surface_finish_presentation_feedback(
+      sfc, wp_presentation_feedback, 0, 0.0, 0.0, 0, 0);
+  wp_presentation_feedback_destroy(wp_presentation_feedback);
+}
+
+void buffer_release(void *data, struct wl_buffer *wl_buffer) {
+  struct samure_shared_buffer *b = (struct samure_shared_buffer *)data;
+  b->busy = 0;
+  if (b->destroyed) {
+    samure_destroy_shared_buffer(b);
+  } else if (b->on_release) {
+    b->on_release(b, b->release_data);
+  }
+}
+
 void fractional_scale_preferred_scale(
     void *data, struct wp_fractional_scale_v1 *wp_fractional_scale_v1,
     uint32_t scale) {
   struct samure_callback_data *d = (struct samure_callback_data *)data;
   struct samure_context *ctx = d->ctx;
   struct samure_layer_surface *sfc = (struct samure_layer_surface *)d->data;
-  struct zwlr_layer_surface_v1 *surface = sfc->layer_surface;
 
   const double new_scale = ((double)scale) / 120.0;
 
@@ -28,6 +28,7 @@
 #include "wayland/cursor-shape.h"
 #include "wayland/fractional-scale.h"
 #include "wayland/layer-shell.h"
+#include "wayland/presentation-time.h"
 #include "wayland/screencopy.h"
 #include "wayland/xdg-output.h"
 #include <wayland-client.h>
@@ -64,6 +65,17 @@ extern void pointer_button(void *data, struct wl_pointer *pointer,
 extern void pointer_axis(void *data, struct wl_pointer *wl_pointer,
                          uint32_t time, uint32_t axis, wl_fixed_t value);
 
+extern void pointer_frame(void *data, struct wl_pointer *wl_pointer);
+
+extern void pointer_axis_source(void *data, struct wl_pointer *wl_pointer,
+                                uint32_t axis_source);
+
+extern void pointer_axis_stop(void *data, struct wl_pointer *wl_pointer,
+                              uint32_t time, uint32_t axis);
+
+extern void pointer_axis_discrete(void *data, struct wl_pointer *wl_pointer,
+                                  uint32_t axis, int32_t discrete);
+
 extern void surface_enter(void *data, struct wl_surface *surface,
                           struct wl_output *output);
 
@@ -194,10 +206,28 @@ extern void touch_orientation(void *data, struct wl_touch *wl_touch, int32_t id,
 extern void frame_done(void *data, struct wl_callback *wl_callback,
                        uint32_t callback_data);
 
+extern void buffer_release(void *data, struct wl_buffer *wl_buffer);
+
 extern void fractional_scale_preferred_scale(
     void *data, struct wp_fractional_scale_v1 *wp_fractional_scale_v1,
     uint32_t scale);
 
+extern void presentation_clock_id(void *data,
+                                  struct wp_presentation *wp_presentation,
+                                  uint32_t clk_id);
+
+extern void presentation_feedback_sync_output(
+    void *data, struct wp_presentation_feedback *wp_presentation_feedback,
+    struct wl_output *output);
+
+extern void presentation_feedback_presented(
+    void *data, struct wp_presentation_feedback *wp_presentation_feedback,
+    uint32_t tv_sec_hi, uint32_t tv_sec_lo, uint32_t tv_nsec, uint32_t refresh,
+    uint32_t seq_hi, uint32_t seq_lo, uint32_t flags);
+
+extern void presentation_feedback_discarded(
+    void *data, struct wp_presentation_feedback *wp_presentation_feedback);
+
 static struct wl_registry_listener registry_listener = {
     .global = registry_global,
     .global_remove = registry_global_remove,
@@ -214,6 +244,10 @@ static struct wl_pointer_listener pointer_listener = {
     .motion = pointer_motion,
     .button = pointer_button,
     .axis = pointer_axis,
+    .frame = pointer_frame,
+    .axis_source = pointer_axis_source,
+    .axis_stop = pointer_axis_stop,
+    .axis_discrete = pointer_axis_discrete,
 };
 
 static struct wl_keyboard_listener keyboard_listener = {
@@ -254,6 +288,28 @@ static struct zxdg_output_v1_listener xdg_output_listener = {
     .description = xdg_output_description,
 };
 
+extern void screencopy_stream_buffer(
+    void *data, struct zwlr_screencopy_frame_v1 *zwlr_screencopy_frame_v1,
+    uint32_t format, uint32_t width, uint32_t height, uint32_t stride);
+
+extern void screencopy_stream_flags(
+    void *data, struct zwlr_screencopy_frame_v1 *zwlr_screencopy_frame_v1,
+    uint32_t flags);
+
+extern void screencopy_stream_ready(
+    void *data, struct zwlr_screencopy_frame_v1 *zwlr_screencopy_frame_v1,
+    uint32_t tv_sec_hi, uint32_t tv_sec_lo, uint32_t tv_nsec);
+
+extern void screencopy_stream_failed(
+    void *data, struct zwlr_screencopy_frame_v1 *zwlr_screencopy_frame_v1);
+
+extern void screencopy_stream_damage(
+    void *data, struct zwlr_screencopy_frame_v1 *zwlr_screencopy_frame_v1,
+    uint32_t x, uint32_t y, uint32_t width, uint32_t height);
+
+extern void screencopy_stream_buffer_done(
+    void *data, struct zwlr_screencopy_frame_v1 *zwlr_screencopy_frame_v1);
+
 static struct zwlr_screencopy_frame_v1_listener screencopy_frame_listener = {
     .buffer = screencopy_frame_buffer,
     .buffer_done = screencopy_frame_buffer_done,
@@ -264,6 +320,16 @@ static struct zwlr_screencopy_frame_v1_listener screencopy_frame_listener = {
     .ready = screencopy_frame_ready,
 };
 
+static struct zwlr_screencopy_frame_v1_listener screencopy_stream_listener = {
+    .buffer = screencopy_stream_buffer,
+    .buffer_done = screencopy_stream_buffer_done,
+    .damage = screencopy_stream_damage,
+    .failed = screencopy_stream_failed,
+    .flags = screencopy_stream_flags,
+    .linux_dmabuf = screencopy_frame_linux_dmabuf,
+    .ready = screencopy_stream_ready,
+};
+
 static struct wl_touch_listener touch_listener = {
     .cancel = touch_cancel,
     .down = touch_down,
@@ -278,10 +344,25 @@ static struct wl_callback_listener frame_listener = {
     .done = frame_done,
 };
 
+static struct wl_buffer_listener buffer_listener = {
+    .release = buffer_release,
+};
+
 static struct wp_fractional_scale_v1_listener fractional_scale_listener = {
     .preferred_scale = fractional_scale_preferred_scale,
 };
 
+static struct wp_presentation_listener presentation_listener = {
+    .clock_id = presentation_clock_id,
+};
+
+static struct wp_presentation_feedback_listener presentation_feedback_listener =
+    {
+        .sync_output = presentation_feedback_sync_output,
+        .presented = presentation_feedback_presented,
+        .discarded = presentation_feedback_discarded,
+};
+
 struct samure_callback_data {
   struct samure_context *ctx;
   void *data;
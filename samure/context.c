@@ -27,9 +27,12 @@
 #include "context.h"
 #include "callbacks.h"
 #include <dlfcn.h>
+#include <errno.h>
+#include <poll.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/eventfd.h>
 #include <unistd.h>
 
 #include "backends/cairo.h"
@@ -38,6 +41,12 @@
 
 SAMURE_DEFINE_RESULT_UNWRAP(context);
 
+static void
+samure_context_render_layer_surface_now(struct samure_context *ctx,
+                                        struct samure_layer_surface *sfc,
+                                        struct samure_rect geo);
+static void samure_context_render_outputs(struct samure_context *ctx);
+
 struct samure_context_config
 samure_create_context_config(samure_event_callback event_callback,
                              samure_render_callback render_callback,
@@ -54,6 +63,8 @@ samure_create_context_config(samure_event_callback event_callback,
 SAMURE_RESULT(context)
 samure_create_context(struct samure_context_config *config) {
   SAMURE_RESULT_ALLOC(context, ctx);
+  ctx->wakeup_fd = -1;
+  ctx->presentation_clock_id = CLOCK_MONOTONIC;
 
   if (config) {
     ctx->config = *config;
@@ -61,20 +72,36 @@ samure_create_context(struct samure_context_config *config) {
     memset(&ctx->config, 0, sizeof(struct samure_context_config));
   }
   ctx->app.on_event = ctx->config.on_event;
+  ctx->app.on_events = ctx->config.on_events;
   ctx->app.on_update = ctx->config.on_update;
   ctx->app.on_render = ctx->config.on_render;
 
+  ctx->events = malloc(SAMURE_NUM_PREALLOCATED_EVENTS *
+                       sizeof(struct samure_event));
+  if (!ctx->events) {
+    SAMURE_DESTROY_ERROR(context, ctx, SAMURE_ERROR_MEMORY);
+  }
+  ctx->cap_events = SAMURE_NUM_PREALLOCATED_EVENTS;
+
   ctx->display = wl_display_connect(NULL);
   if (ctx->display == NULL) {
     SAMURE_DESTROY_ERROR(context, ctx, SAMURE_ERROR_DISPLAY_CONNECT);
   }
 
+  ctx->wakeup_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+  if (ctx->wakeup_fd < 0) {
+    SAMURE_DESTROY_ERROR(context, ctx, SAMURE_ERROR_FAILED);
+  }
+
   struct samure_registry_data reg_d = {0};
 
-  struct wl_registry *registry = wl_display_get_registry(ctx->display);
-  wl_registry_add_listener(registry, &registry_listener,
-                           samure_create_callback_data(ctx, &reg_d));
+  ctx->registry = wl_display_get_registry(ctx->display);
+  struct samure_callback_data *reg_cbd =
+      samure_create_callback_data(ctx, &reg_d);
+  wl_registry_add_listener(ctx->registry, &registry_listener, reg_cbd);
   wl_display_roundtrip(ctx->display);
+  // From now on new outputs are added directly to the context
+  reg_cbd->data = NULL;
 
   samure_error error_code = SAMURE_ERROR_NONE;
 
@@ -87,17 +114,39 @@ samure_create_context(struct samure_context_config *config) {
   // clang-format on
 
   if (SAMURE_IS_ERROR(error_code)) {
+    for (size_t i = 0; i < reg_d.num_outputs; i++) {
+      samure_destroy_output(ctx, reg_d.outputs[i]);
+    }
+    free(reg_d.outputs);
     SAMURE_DESTROY_ERROR(context, ctx, error_code);
   }
 
+  ctx->outputs = reg_d.outputs;
+  ctx->num_outputs = reg_d.num_outputs;
+
+  SAMURE_RESULT(shm_arena)
+  a_rs = samure_create_shm_arena(ctx->shm, ctx->config.huge_pages);
+  if (!SAMURE_HAS_ERROR(a_rs)) {
+    ctx->shm_arena = SAMURE_UNWRAP(shm_arena, a_rs);
+  }
+
+  if (ctx->config.num_worker_threads != 0) {
+    SAMURE_RESULT(worker_pool)
+    w_rs = samure_create_worker_pool(ctx->config.num_worker_threads);
+    if (SAMURE_HAS_ERROR(w_rs)) {
+      SAMURE_DESTROY_ERROR(context, ctx, w_rs.error);
+    }
+    ctx->worker_pool = SAMURE_UNWRAP(worker_pool, w_rs);
+  }
+
   if (ctx->config.force_client_cursors && reg_d.cursor_manager) {
     wp_cursor_shape_manager_v1_destroy(reg_d.cursor_manager);
     reg_d.cursor_manager = NULL;
   }
 
   if (reg_d.num_seats != 0) {
-    ctx->seats = malloc(ctx->num_seats * sizeof(struct samure_seat *));
-    for (size_t i = 0; i < reg_d.num_seats; i++) {
+    ctx->seats = malloc(reg_d.num_seats * sizeof(struct samure_seat *));
+    for (size_t i = 0; ctx->seats && i < reg_d.num_seats; i++) {
       SAMURE_RESULT(seat) s_rs = samure_create_seat(ctx, reg_d.seats[i]);
       if (!SAMURE_HAS_ERROR(s_rs)) {
         ctx->seats[ctx->num_seats] = SAMURE_UNWRAP(seat, s_rs);
@@ -107,6 +156,15 @@ samure_create_context(struct samure_context_config *config) {
   }
   free(reg_d.seats);
 
+  // The xdg output manager might have been announced after some outputs
+  for (size_t i = 0; i < ctx->num_outputs; i++) {
+    samure_output_create_xdg_output(ctx, ctx->outputs[i]);
+  }
+
+  // Retrieve the capabilities of all seats and the geometry of all outputs at
+  // once
+  wl_display_roundtrip(ctx->display);
+
   SAMURE_RESULT(cursor_engine)
   ce_rs = samure_create_cursor_engine(ctx, reg_d.cursor_manager);
   if (!SAMURE_HAS_ERROR(ce_rs)) {
@@ -134,6 +192,8 @@ samure_create_context(struct samure_context_config *config) {
                            SAMURE_ERROR_BACKEND_INIT | c_rs.error);
     }
     ctx->backend = SAMURE_UNWRAP(backend, c_rs);
+    // Every layer surface has its own cairo context
+    ctx->backend->thread_safe_rendering = 1;
   } break;
   case SAMURE_BACKEND_NONE:
     break;
@@ -148,18 +208,6 @@ samure_create_context(struct samure_context_config *config) {
   } break;
   }
 
-  ctx->outputs = malloc(reg_d.num_outputs * sizeof(struct samure_output *));
-  if (ctx->outputs) {
-    for (size_t i = 0; i < reg_d.num_outputs; i++) {
-      SAMURE_RESULT(output) o_rs = samure_create_output(ctx, reg_d.outputs[i]);
-      if (!SAMURE_HAS_ERROR(o_rs)) {
-        ctx->outputs[ctx->num_outputs] = SAMURE_UNWRAP(output, o_rs);
-        ctx->num_outputs++;
-      }
-    }
-  }
-  free(reg_d.outputs);
-
   if (ctx->config.max_update_frequency == 0) {
     // Assume that monitors have 60Hz refresh rate and use double of that as
     // update frequency
@@ -200,7 +248,7 @@ samure_create_context_with_backend(struct samure_context_config *config,
   ctx_rs.result->backend = backend;
 
   if (!not_create_output_layer_surfaces) {
-    cfg.not_create_output_layer_surfaces = 0;
+    ctx_rs.result->config.not_create_output_layer_surfaces = 0;
     const samure_error err =
         samure_context_create_output_layer_surfaces(ctx_rs.result);
     if (SAMURE_IS_ERROR(err)) {
@@ -227,6 +275,18 @@ void samure_destroy_context(struct samure_context *ctx) {
     samure_destroy_output(ctx, ctx->outputs[i]);
   }
   free(ctx->outputs);
+  for (size_t i = 0; i < ctx->num_pending_outputs; i++) {
+    samure_destroy_output(ctx, ctx->pending_outputs[i]);
+  }
+  free(ctx->pending_outputs);
+  while (ctx->num_screenshots != 0) {
+    samure_destroy_screenshot(ctx, ctx->screenshots[0]);
+  }
+  free(ctx->screenshots);
+  while (ctx->num_screencopy_streams != 0) {
+    samure_destroy_screencopy_stream(ctx, ctx->screencopy_streams[0]);
+  }
+  free(ctx->screencopy_streams);
 
   if (ctx->backend && ctx->backend->destroy) {
     ctx->backend->destroy(ctx);
@@ -235,6 +295,11 @@ void samure_destroy_context(struct samure_context *ctx) {
     dlclose(ctx->backend_lib_handle);
   }
 
+  if (ctx->shm_arena)
+    samure_destroy_shm_arena(ctx->shm_arena);
+  if (ctx->worker_pool)
+    samure_destroy_worker_pool(ctx->worker_pool);
+
   if (ctx->shm)
     wl_shm_destroy(ctx->shm);
   if (ctx->compositor)
@@ -251,47 +316,326 @@ void samure_destroy_context(struct samure_context *ctx) {
     wp_fractional_scale_manager_v1_destroy(ctx->fractional_scale_manager);
   if (ctx->viewporter)
     wp_viewporter_destroy(ctx->viewporter);
+  if (ctx->presentation)
+    wp_presentation_destroy(ctx->presentation);
+
+  if (ctx->registry) {
+    free(wl_registry_get_user_data(ctx->registry));
+    wl_registry_destroy(ctx->registry);
+  }
 
   if (ctx->display)
     wl_display_disconnect(ctx->display);
+  if (ctx->wakeup_fd >= 0)
+    close(ctx->wakeup_fd);
 
   free(ctx->events);
+  free(ctx->motion_samples);
+  free(ctx->render_jobs);
   free(ctx);
 }
 
+// Sends the queued requests to the compositor. Returns 1 if some of them could
+// not be sent because the socket buffer is full
+static int samure_context_flush(struct samure_context *ctx) {
+  ctx->unsent_requests =
+      wl_display_flush(ctx->display) == -1 && errno == EAGAIN;
+  return ctx->unsent_requests;
+}
+
+static int samure_context_is_idle(struct samure_context *ctx) {
+  return ctx->config.sleep_when_idle &&
+         ctx->render_state == SAMURE_RENDER_STATE_NONE;
+}
+
+// Whether the outputs are currently rendered at their own refresh rates
+static int samure_context_uses_output_cadence(struct samure_context *ctx) {
+  return ctx->config.per_output_refresh &&
+         ctx->render_state == SAMURE_RENDER_STATE_ALWAYS;
+}
+
+// Returns 1 and starts a new frame of the output if it is due to be rendered
+// at its refresh rate
+static int samure_context_output_frame_due(struct samure_context *ctx,
+                                           struct samure_output *o) {
+  // Round up so that the compositor is never waiting on us
+  const uint32_t frequency = o->refresh_rate > 0
+                                 ? ((uint32_t)o->refresh_rate + 999) / 1000
+                                 : ctx->config.max_update_frequency;
+  if (o->frame_timer.max_update_frequency != frequency) {
+    o->frame_timer = samure_init_frame_timer(frequency);
+  }
+
+  if (samure_frame_timer_get_timeout(&o->frame_timer) > 0.0) {
+    return 0;
+  }
+
+  samure_frame_timer_tick(&o->frame_timer);
+  return 1;
+}
+
+// Returns the absolute time at which the next frame or deferred render is due
+// or -1 if the context is idle and nothing is scheduled
+static double samure_context_get_wakeup_time(struct samure_context *ctx) {
+  double wakeup_time = -1.0;
+  if (!samure_context_is_idle(ctx)) {
+    wakeup_time = ctx->frame_timer.start_time == 0.0
+                      ? samure_get_time()
+                      : ctx->frame_timer.next_frame_time;
+  }
+
+  for (size_t i = 0; i < ctx->num_outputs; i++) {
+    struct samure_output *o = ctx->outputs[i];
+    if (samure_context_uses_output_cadence(ctx)) {
+      const double frame_time = o->frame_timer.start_time == 0.0
+                                    ? samure_get_time()
+                                    : o->frame_timer.next_frame_time;
+      if (wakeup_time < 0.0 || frame_time < wakeup_time) {
+        wakeup_time = frame_time;
+      }
+    }
+
+    for (size_t j = 0; j < o->num_sfc; j++) {
+      const double render_at = o->sfc[j]->render_at;
+      if (render_at != 0.0 && (wakeup_time < 0.0 || render_at < wakeup_time)) {
+        wakeup_time = render_at;
+      }
+    }
+  }
+
+  return wakeup_time;
+}
+
+// Renders all layer surfaces whose deferred render is due
+static void samure_context_render_deferred(struct samure_context *ctx) {
+  const double now = samure_get_time();
+  for (size_t i = 0; i < ctx->num_outputs; i++) {
+    struct samure_output *o = ctx->outputs[i];
+    for (size_t j = 0; j < o->num_sfc; j++) {
+      struct samure_layer_surface *sfc = o->sfc[j];
+      if (sfc->render_at != 0.0 && sfc->render_at <= now) {
+        sfc->render_at = 0.0;
+        samure_context_render_layer_surface_now(ctx, sfc, sfc->render_geo);
+      }
+    }
+  }
+}
+
 void samure_context_run(struct samure_context *ctx) {
+  // Make sure that all surfaces received their first configure
+  wl_display_roundtrip(ctx->display);
   samure_context_process_events(ctx);
 
   if (ctx->render_state != SAMURE_RENDER_STATE_NONE) {
-    for (size_t i = 0; i < ctx->num_outputs; i++) {
-      samure_context_render_output(ctx, ctx->outputs[i]);
-    }
+    samure_context_render_outputs(ctx);
   }
 
   ctx->running = 1;
   while (ctx->running) {
-    samure_frame_timer_start_frame(&ctx->frame_timer);
+    samure_context_step(ctx);
+    if (!ctx->running) {
+      break;
+    }
+
+    if (samure_context_is_idle(ctx)) {
+      // Sleep until the compositor sends events, someone wakes us up or a
+      // deferred render is due. If not all requests could be sent, wake up as
+      // soon as the socket is writable again, because the compositor can not
+      // answer requests it never received
+      const int unsent = samure_context_flush(ctx);
+      struct pollfd fds[2] = {
+          {.fd = wl_display_get_fd(ctx->display),
+           .events = POLLIN | (unsent ? POLLOUT : 0)},
+          {.fd = ctx->wakeup_fd, .events = POLLIN},
+      };
+      if (poll(fds, 2, samure_context_get_timeout(ctx)) > 0 &&
+          (fds[0].revents & POLLOUT)) {
+        samure_context_flush(ctx);
+      }
+      continue;
+    }
 
-    samure_context_process_events(ctx);
+    samure_sleep_until(samure_context_get_wakeup_time(ctx));
+  }
+}
+
+int samure_context_get_fd(struct samure_context *ctx) {
+  return wl_display_get_fd(ctx->display);
+}
+
+short samure_context_get_poll_events(struct samure_context *ctx) {
+  return ctx->unsent_requests ? POLLIN | POLLOUT : POLLIN;
+}
+
+int samure_context_get_wakeup_fd(struct samure_context *ctx) {
+  return ctx->wakeup_fd;
+}
+
+void samure_context_wakeup(struct samure_context *ctx) {
+  const uint64_t value = 1;
+  if (write(ctx->wakeup_fd, &value, sizeof(value)) < 0) {
+    DEBUG_PRINT("failed to wake up context\n");
+  }
+}
+
+int samure_context_get_timeout(struct samure_context *ctx) {
+  const double wakeup_time = samure_context_get_wakeup_time(ctx);
+  if (wakeup_time < 0.0) {
+    return -1;
+  }
+
+  double timeout = (wakeup_time - samure_get_time()) * 1000.0;
+  if (timeout < 0.0) {
+    timeout = 0.0;
+  }
+  // Round up so that the frame is due when the caller wakes up
+  const int timeout_ms = (int)timeout;
+  return (double)timeout_ms < timeout ? timeout_ms + 1 : timeout_ms;
+}
+
+void samure_context_step(struct samure_context *ctx) {
+  uint64_t wakeups = 0;
+  if (read(ctx->wakeup_fd, &wakeups, sizeof(wakeups)) < 0) {
+    wakeups = 0;
+  }
+
+  samure_context_process_events(ctx);
+  samure_context_render_deferred(ctx);
+
+  if (wakeups == 0 && samure_context_is_idle(ctx)) {
+    // Do not count the idle time into the delta time of the next frame
+    ctx->frame_timer.start_time = 0.0;
+    samure_context_flush(ctx);
+    return;
+  }
+
+  if (samure_frame_timer_get_timeout(&ctx->frame_timer) == 0.0) {
+    samure_frame_timer_tick(&ctx->frame_timer);
 
     samure_context_update(ctx, ctx->frame_timer.delta_time);
 
-    if (ctx->render_state != SAMURE_RENDER_STATE_NONE) {
-      for (size_t i = 0; i < ctx->num_outputs; i++) {
-        samure_context_render_output(ctx, ctx->outputs[i]);
-      }
+    if (ctx->render_state != SAMURE_RENDER_STATE_NONE &&
+        !samure_context_uses_output_cadence(ctx)) {
+      samure_context_render_outputs(ctx);
       if (ctx->render_state == SAMURE_RENDER_STATE_ONCE) {
         ctx->render_state = SAMURE_RENDER_STATE_NONE;
       }
     }
+  }
+
+  if (samure_context_uses_output_cadence(ctx)) {
+    samure_context_render_outputs(ctx);
+  }
+
+  samure_context_flush(ctx);
+}
+
+// Dispatches events until none of the screenshots is pending anymore
+static void samure_wait_for_screenshots(struct samure_context *ctx,
+                                        struct samure_screenshot_data *data,
+                                        size_t num_data) {
+  for (;;) {
+    size_t num_pending = 0;
+    for (size_t i = 0; i < num_data; i++) {
+      if (data[i].state == SAMURE_SCREENSHOT_PENDING) {
+        num_pending++;
+      }
+    }
+
+    if (num_pending == 0 || wl_display_dispatch(ctx->display) == -1) {
+      return;
+    }
+  }
+}
+
+samure_error
+samure_context_screenshot_all(struct samure_context *ctx,
+                              struct samure_shared_buffer **buffers,
+                              int capture_cursor) {
+  samure_error error_code = SAMURE_ERROR_NONE;
+  if (!ctx->shm)
+    error_code |= SAMURE_ERROR_NO_SHM;
+  if (!ctx->screencopy_manager)
+    error_code |= SAMURE_ERROR_NO_SCREENCOPY_MANAGER;
+  if (error_code != SAMURE_ERROR_NONE) {
+    return error_code;
+  }
+
+  // Outputs can be removed while dispatching, so only the ones present now
+  // are used. They are not destroyed before the events are processed
+  const size_t num_outputs = ctx->num_outputs;
+  struct samure_screenshot_data *data =
+      calloc(num_outputs, sizeof(struct samure_screenshot_data));
+  struct zwlr_screencopy_frame_v1 **frames =
+      calloc(num_outputs, sizeof(struct zwlr_screencopy_frame_v1 *));
+  if ((!data || !frames) && num_outputs != 0) {
+    free(data);
+    free(frames);
+    return SAMURE_ERROR_MEMORY;
+  }
+
+  // Request the buffer parameters of all outputs at once
+  for (size_t i = 0; i < num_outputs; i++) {
+    buffers[i] = NULL;
+    data[i].ctx = ctx;
+    data[i].output = ctx->outputs[i];
+    data[i].buffer_rs.error = SAMURE_ERROR_NOT_IMPLEMENTED;
+
+    frames[i] = zwlr_screencopy_manager_v1_capture_output(
+        ctx->screencopy_manager, capture_cursor, data[i].output->output);
+    if (!frames[i]) {
+      data[i].state = SAMURE_SCREENSHOT_FAILED;
+      data[i].buffer_rs.error = SAMURE_ERROR_FRAME_INIT;
+      continue;
+    }
+    zwlr_screencopy_frame_v1_add_listener(frames[i], &screencopy_frame_listener,
+                                          &data[i]);
+  }
+
+  samure_wait_for_screenshots(ctx, data, num_outputs);
+
+  // Copy all frames at once
+  for (size_t i = 0; i < num_outputs; i++) {
+    if (data[i].state == SAMURE_SCREENSHOT_PENDING ||
+        data[i].state == SAMURE_SCREENSHOT_FAILED ||
+        SAMURE_HAS_ERROR(data[i].buffer_rs)) {
+      data[i].state = SAMURE_SCREENSHOT_FAILED;
+      continue;
+    }
+
+    data[i].state = SAMURE_SCREENSHOT_PENDING;
+    zwlr_screencopy_frame_v1_copy(frames[i], data[i].buffer_rs.result->buffer);
+  }
+
+  samure_wait_for_screenshots(ctx, data, num_outputs);
+
+  for (size_t i = 0; i < num_outputs; i++) {
+    if (data[i].state == SAMURE_SCREENSHOT_READY) {
+      buffers[i] = SAMURE_UNWRAP(shared_buffer, data[i].buffer_rs);
+    } else {
+      error_code |= SAMURE_ERROR_FAILED;
+      if (SAMURE_HAS_ERROR(data[i].buffer_rs)) {
+        error_code |= data[i].buffer_rs.error;
+      } else {
+        samure_destroy_shared_buffer(data[i].buffer_rs.result);
+      }
+    }
 
-    samure_frame_timer_end_frame(&ctx->frame_timer);
+    if (frames[i]) {
+      zwlr_screencopy_frame_v1_destroy(frames[i]);
+    }
   }
+
+  free(data);
+  free(frames);
+  return error_code;
 }
 
 struct samure_rect samure_context_get_output_rect(struct samure_context *ctx) {
   if (ctx->num_outputs == 0) {
+    // All outputs can be unplugged at runtime
     struct samure_rect r = {.x = 0, .y = 0, .w = 0, .h = 0};
+    return r;
   }
 
   struct samure_rect r = {
@@ -366,8 +710,182 @@ void samure_context_set_keyboard_interaction(struct samure_context *ctx,
   }
 }
 
+// Reads and dispatches the wayland events that have already arrived without
+// blocking. Returns -1 if the connection to the compositor has been lost
+static int samure_context_dispatch_events(struct samure_context *ctx) {
+  while (wl_display_prepare_read(ctx->display) != 0) {
+    if (wl_display_dispatch_pending(ctx->display) == -1) {
+      return -1;
+    }
+  }
+
+  // Send the requests of the last frame before looking for new events. If the
+  // socket buffer is full the rest is sent as soon as it is writable again
+  const int unsent = samure_context_flush(ctx);
+
+  struct pollfd fd = {
+      .fd = wl_display_get_fd(ctx->display),
+      .events = POLLIN | (unsent ? POLLOUT : 0),
+  };
+  if (poll(&fd, 1, 0) <= 0) {
+    fd.revents = 0;
+  }
+  if (fd.revents & POLLOUT) {
+    samure_context_flush(ctx);
+  }
+  if (fd.revents & POLLIN) {
+    if (wl_display_read_events(ctx->display) == -1) {
+      return -1;
+    }
+  } else {
+    wl_display_cancel_read(ctx->display);
+  }
+
+  return wl_display_dispatch_pending(ctx->display);
+}
+
+struct samure_event *samure_context_new_event(struct samure_context *ctx) {
+  if (ctx->num_events == ctx->cap_events) {
+    const size_t cap_events = ctx->cap_events == 0
+                                  ? SAMURE_NUM_PREALLOCATED_EVENTS
+                                  : ctx->cap_events * 2;
+    struct samure_event *events =
+        realloc(ctx->events, cap_events * sizeof(struct samure_event));
+    if (!events) {
+      return NULL;
+    }
+    ctx->events = events;
+    ctx->cap_events = cap_events;
+  }
+
+  struct samure_event *e = &ctx->events[ctx->num_events];
+  memset(e, 0, sizeof(struct samure_event));
+  ctx->num_events++;
+  return e;
+}
+
+void samure_context_add_pending_output(struct samure_context *ctx,
+                                       struct samure_output *output) {
+  struct samure_output **pending_outputs =
+      realloc(ctx->pending_outputs,
+              (ctx->num_pending_outputs + 1) * sizeof(struct samure_output *));
+  if (!pending_outputs) {
+    samure_destroy_output(ctx, output);
+    return;
+  }
+  ctx->pending_outputs = pending_outputs;
+  ctx->pending_outputs[ctx->num_pending_outputs] = output;
+  ctx->num_pending_outputs++;
+}
+
+// Removes an output from the array while keeping the order of the others
+static void samure_remove_output_at(struct samure_output **outputs,
+                                    size_t *num_outputs, size_t index) {
+  memmove(&outputs[index], &outputs[index + 1],
+          (*num_outputs - index - 1) * sizeof(struct samure_output *));
+  (*num_outputs)--;
+}
+
+static void samure_clear_focus(struct samure_focus *focus,
+                               struct samure_output *output) {
+  if (focus->output == output) {
+    focus->output = NULL;
+    focus->surface = NULL;
+  }
+}
+
+void samure_context_remove_output(struct samure_context *ctx,
+                                  uint32_t registry_name) {
+  for (size_t i = 0; i < ctx->num_pending_outputs; i++) {
+    if (ctx->pending_outputs[i]->registry_name == registry_name) {
+      // The application does not know about it yet
+      samure_destroy_output(ctx, ctx->pending_outputs[i]);
+      samure_remove_output_at(ctx->pending_outputs, &ctx->num_pending_outputs,
+                              i);
+      return;
+    }
+  }
+
+  for (size_t i = 0; i < ctx->num_outputs; i++) {
+    struct samure_output *o = ctx->outputs[i];
+    if (o->registry_name != registry_name) {
+      continue;
+    }
+
+    struct samure_event *e = samure_context_new_event(ctx);
+    if (!e) {
+      // Better leak the output than leave the application with a dangling
+      // pointer
+      return;
+    }
+    e->type = SAMURE_EVENT_OUTPUT_REMOVED;
+    e->output = o;
+
+    samure_remove_output_at(ctx->outputs, &ctx->num_outputs, i);
+    for (size_t j = 0; j < ctx->num_seats; j++) {
+      samure_clear_focus(&ctx->seats[j]->pointer_focus, o);
+      samure_clear_focus(&ctx->seats[j]->keyboard_focus, o);
+      samure_clear_focus(&ctx->seats[j]->touch_focus, o);
+    }
+    return;
+  }
+}
+
+// Moves the pending outputs whose properties have arrived to the outputs of
+// the context and creates their layer surfaces
+static void samure_context_announce_outputs(struct samure_context *ctx) {
+  for (size_t i = 0; i < ctx->num_pending_outputs;) {
+    struct samure_output *o = ctx->pending_outputs[i];
+    if (!o->done) {
+      i++;
+      continue;
+    }
+
+    struct samure_output **outputs =
+        realloc(ctx->outputs,
+                (ctx->num_outputs + 1) * sizeof(struct samure_output *));
+    if (!outputs) {
+      return;
+    }
+    ctx->outputs = outputs;
+    ctx->outputs[ctx->num_outputs] = o;
+    ctx->num_outputs++;
+    samure_remove_output_at(ctx->pending_outputs, &ctx->num_pending_outputs,
+                            i);
+
+    if (!ctx->config.not_create_output_layer_surfaces) {
+      // Waiting for the configure here would block the event processing, so
+      // the layer surface is finished once its configure arrives
+      SAMURE_RESULT(layer_surface)
+      sfc_rs = samure_begin_create_layer_surface(
+          ctx, o, SAMURE_LAYER_OVERLAY, SAMURE_LAYER_SURFACE_ANCHOR_FILL,
+          (uint32_t)ctx->config.keyboard_interaction,
+          ctx->config.pointer_interaction || ctx->config.touch_interaction);
+      if (!SAMURE_HAS_ERROR(sfc_rs)) {
+        struct samure_layer_surface *sfc = SAMURE_UNWRAP(layer_surface, sfc_rs);
+        sfc->pending_creation = 1;
+        samure_output_attach_layer_surface(o, sfc);
+      }
+    }
+
+    struct samure_event *e = samure_context_new_event(ctx);
+    if (e) {
+      e->type = SAMURE_EVENT_OUTPUT_ADDED;
+      e->output = o;
+    }
+  }
+}
+
 void samure_context_process_events(struct samure_context *ctx) {
-  wl_display_roundtrip(ctx->display);
+  if (samure_context_dispatch_events(ctx) == -1) {
+    DEBUG_PRINT("lost connection to the compositor\n");
+    ctx->running = 0;
+  }
+
+  samure_context_announce_outputs(ctx);
+  for (size_t i = 0; i < ctx->num_screencopy_streams; i++) {
+    samure_screencopy_stream_resume(ctx->screencopy_streams[i]);
+  }
 
   // Process events
   for (; ctx->event_index < ctx->num_events; ctx->event_index++) {
@@ -378,7 +896,19 @@ void samure_context_process_events(struct samure_context *ctx) {
       e->surface->w = e->width;
       e->surface->h = e->height;
 
-      if (ctx->backend && ctx->backend->on_layer_surface_configure) {
+      if (e->surface->pending_creation) {
+        // The backend association already uses the configured size
+        e->surface->pending_creation = 0;
+        samure_end_create_layer_surface(ctx, e->surface, 0);
+        if (ctx->backend && ctx->backend->associate_layer_surface &&
+            SAMURE_IS_ERROR(
+                ctx->backend->associate_layer_surface(ctx, e->surface))) {
+          samure_output_detach_layer_surface(e->surface->output, e->surface);
+          samure_destroy_layer_surface(ctx, e->surface);
+          e->surface = NULL;
+          break;
+        }
+      } else if (ctx->backend && ctx->backend->on_layer_surface_configure) {
         ctx->backend->on_layer_surface_configure(ctx, e->surface, e->width,
                                                  e->height);
       }
@@ -387,29 +917,127 @@ void samure_context_process_events(struct samure_context *ctx) {
 
       break;
     default:
-      if (ctx->app.on_event) {
+      if (!ctx->app.on_events && ctx->app.on_event) {
         ctx->app.on_event(ctx, e, ctx->config.user_data);
       }
       break;
     }
   }
+
+  if (ctx->app.on_events && ctx->num_events != 0) {
+    ctx->app.on_events(ctx, ctx->events, ctx->num_events,
+                       ctx->config.user_data);
+  }
+
+  // The application is done with the removed outputs, finished screenshots
+  // and captured frames
+  for (size_t i = 0; i < ctx->num_events; i++) {
+    switch (ctx->events[i].type) {
+    case SAMURE_EVENT_OUTPUT_REMOVED:
+      samure_destroy_output(ctx, ctx->events[i].output);
+      break;
+    case SAMURE_EVENT_SCREENSHOT_READY:
+    case SAMURE_EVENT_SCREENSHOT_FAILED:
+      samure_destroy_screenshot(ctx, ctx->events[i].screenshot);
+      break;
+    case SAMURE_EVENT_SCREENCOPY_FRAME:
+      // The stream might have been destroyed by the application
+      for (size_t j = 0; j < ctx->num_screencopy_streams; j++) {
+        if (ctx->screencopy_streams[j] == ctx->events[i].screencopy_stream) {
+          samure_screencopy_stream_frame_processed(
+              ctx->events[i].screencopy_stream,
+              ctx->events[i].screencopy_frame);
+          break;
+        }
+      }
+      break;
+    default:
+      break;
+    }
+  }
   ctx->event_index = 0;
   ctx->num_events = 0;
+  ctx->num_motion_samples = 0;
+}
+
+size_t samure_context_get_motion_samples(struct samure_context *ctx,
+                                         const struct samure_event *e,
+                                         struct samure_motion_sample *samples,
+                                         size_t max_samples) {
+  const size_t event_index = e - ctx->events;
+  size_t num_samples = 0;
+  for (size_t i = 0;
+       i < ctx->num_motion_samples && num_samples < max_samples; i++) {
+    if (ctx->motion_samples[i].event_index == event_index) {
+      samples[num_samples] = ctx->motion_samples[i].sample;
+      num_samples++;
+    }
+  }
+  return num_samples;
+}
+
+// Returns 1 if sfc should be rendered now. Otherwise the render is postponed
+// until the layer surface is ready or the scheduled render time is reached
+static int samure_context_layer_surface_due(struct samure_context *ctx,
+                                            struct samure_layer_surface *sfc,
+                                            struct samure_rect geo) {
+  if (!sfc->configured) {
+    return 0;
+  }
+
+  if (!ctx->config.not_request_frame && sfc->not_ready) {
+    sfc->dirty = 1;
+    return 0;
+  }
+
+  if (ctx->config.render_deadline_scheduling) {
+    if (sfc->render_at != 0.0) {
+      // A render is already scheduled
+      sfc->render_geo = geo;
+      return 0;
+    }
+
+    const double render_at = samure_layer_surface_get_render_start_time(
+        sfc, ctx->presentation_clock_id,
+        ctx->config.render_deadline_margin == 0.0
+            ? SAMURE_DEFAULT_RENDER_DEADLINE_MARGIN
+            : ctx->config.render_deadline_margin);
+    if (render_at > samure_get_time()) {
+      sfc->render_at = render_at;
+      sfc->render_geo = geo;
+      return 0;
+    }
+  }
+
+  return 1;
 }
 
 void samure_context_render_layer_surface(struct samure_context *ctx,
                                          struct samure_layer_surface *sfc,
                                          struct samure_rect geo) {
-  if (!sfc->configured) {
-    return;
+  if (samure_context_layer_surface_due(ctx, sfc, geo)) {
+    samure_context_render_layer_surface_now(ctx, sfc, geo);
+  }
+}
+
+// Everything that needs to happen on the wayland thread before on_render.
+// Returns 0 if the backend has no free buffer. Then the render is retried
+// when the compositor releases one
+static int samure_context_begin_render(struct samure_context *ctx,
+                                       struct samure_layer_surface *sfc,
+                                       struct samure_rect geo) {
+  sfc->no_buffer = 0;
+  if (ctx->backend && ctx->backend->render_start) {
+    ctx->backend->render_start(ctx, sfc);
   }
 
-  if (!ctx->config.not_request_frame) {
-    if (sfc->not_ready) {
-      sfc->dirty = 1;
-      return;
-    }
+  if (sfc->no_buffer) {
+    sfc->dirty = 1;
+    sfc->render_geo = geo;
+    return 0;
+  }
 
+  if (!ctx->config.not_request_frame) {
     samure_layer_surface_request_frame(ctx, sfc, geo);
   }
 
@@ -417,21 +1045,44 @@ void samure_context_render_layer_surface(struct samure_context *ctx,
   sfc->frame_delta_time = end_time - sfc->frame_start_time;
   sfc->frame_start_time = end_time;
 
-  if (ctx->backend && ctx->backend->render_start) {
-    ctx->backend->render_start(ctx, sfc);
-  }
+  return 1;
+}
 
-  if (ctx->app.on_render) {
-    ctx->app.on_render(ctx, sfc, geo, ctx->config.user_data);
-  }
+// Everything that needs to happen on the wayland thread after on_render.
+// render_time is how long on_render took for this layer surface alone
+static void samure_context_end_render(struct samure_context *ctx,
+                                      struct samure_layer_surface *sfc,
+                                      double render_time) {
+  const double start_time = samure_get_time();
+
+  samure_layer_surface_request_presentation_feedback(ctx, sfc);
 
   if (ctx->backend && ctx->backend->render_end) {
     ctx->backend->render_end(ctx, sfc);
   }
 
+  samure_layer_surface_store_render_cost(
+      sfc, render_time + samure_get_time() - start_time);
+
   sfc->dirty = 0;
 }
 
+static void
+samure_context_render_layer_surface_now(struct samure_context *ctx,
+                                        struct samure_layer_surface *sfc,
+                                        struct samure_rect geo) {
+  if (!samure_context_begin_render(ctx, sfc, geo)) {
+    return;
+  }
+
+  if (ctx->app.on_render) {
+    ctx->app.on_render(ctx, sfc, geo, ctx->config.user_data);
+  }
+
+  samure_context_end_render(ctx, sfc,
+                            samure_get_time() - sfc->frame_start_time);
+}
+
 void samure_context_render_output(struct samure_context *ctx,
                                   struct samure_output *output) {
   for (size_t i = 0; i < output->num_sfc; i++) {
@@ -439,6 +1090,95 @@ void samure_context_render_output(struct samure_context *ctx,
   }
 }
 
+static void samure_context_render_job(void *data, size_t index) {
+  struct samure_context *ctx = (struct samure_context *)data;
+  struct samure_render_job *job = &ctx->render_jobs[index];
+  const double start_time = samure_get_time();
+  ctx->app.on_render(ctx, job->sfc, job->geo, ctx->config.user_data);
+  job->render_time = samure_get_time() - start_time;
+}
+
+// Adds a render job and returns 0 if there is no memory for it
+static int samure_context_push_render_job(struct samure_context *ctx,
+                                          struct samure_layer_surface *sfc,
+                                          struct samure_rect geo) {
+  if (ctx->num_render_jobs == ctx->cap_render_jobs) {
+    const size_t cap_render_jobs =
+        ctx->cap_render_jobs == 0 ? 4 : ctx->cap_render_jobs * 2;
+    struct samure_render_job *render_jobs = realloc(
+        ctx->render_jobs, cap_render_jobs * sizeof(struct samure_render_job));
+    if (!render_jobs) {
+      return 0;
+    }
+    ctx->render_jobs = render_jobs;
+    ctx->cap_render_jobs = cap_render_jobs;
+  }
+
+  ctx->render_jobs[ctx->num_render_jobs].sfc = sfc;
+  ctx->render_jobs[ctx->num_render_jobs].geo = geo;
+  ctx->render_jobs[ctx->num_render_jobs].render_time = 0.0;
+  ctx->num_render_jobs++;
+  return 1;
+}
+
+// Renders all outputs or only the ones that are due with per_output_refresh.
+// With parallel_rendering the wayland requests are made on this thread and
+// only the render callbacks run on the worker pool
+static void samure_context_render_outputs(struct samure_context *ctx) {
+  const int output_cadence = samure_context_uses_output_cadence(ctx);
+
+  if (!ctx->config.parallel_rendering || !ctx->worker_pool ||
+      !ctx->app.on_render ||
+      (ctx->backend && !ctx->backend->thread_safe_rendering)) {
+    for (size_t i = 0; i < ctx->num_outputs; i++) {
+      if (!output_cadence ||
+          samure_context_output_frame_due(ctx, ctx->outputs[i])) {
+        samure_context_render_output(ctx, ctx->outputs[i]);
+      }
+    }
+    return;
+  }
+
+  ctx->num_render_jobs = 0;
+  for (size_t i = 0; i < ctx->num_outputs; i++) {
+    struct samure_output *o = ctx->outputs[i];
+    if (output_cadence && !samure_context_output_frame_due(ctx, o)) {
+      continue;
+    }
+
+    for (size_t j = 0; j < o->num_sfc; j++) {
+      if (!samure_context_layer_surface_due(ctx, o->sfc[j], o->geo)) {
+        continue;
+      }
+      if (!samure_context_push_render_job(ctx, o->sfc[j], o->geo)) {
+        samure_context_render_layer_surface_now(ctx, o->sfc[j], o->geo);
+      }
+    }
+  }
+
+  // Only keep the jobs whose layer surfaces have a buffer to render into
+  size_t num_render_jobs = 0;
+  for (size_t i = 0; i < ctx->num_render_jobs; i++) {
+    if (samure_context_begin_render(ctx, ctx->render_jobs[i].sfc,
+                                    ctx->render_jobs[i].geo)) {
+      ctx->render_jobs[num_render_jobs] = ctx->render_jobs[i];
+      num_render_jobs++;
+    }
+  }
+  ctx->num_render_jobs = num_render_jobs;
+
+  ctx->rendering_in_parallel = 1;
+  samure_worker_pool_run(ctx->worker_pool, ctx->num_render_jobs,
+                         samure_context_render_job, ctx);
+  ctx->rendering_in_parallel = 0;
+
+  for (size_t i = 0; i < ctx->num_render_jobs; i++) {
+    samure_context_end_render(ctx, ctx->render_jobs[i].sfc,
+                              ctx->render_jobs[i].render_time);
+  }
+  ctx->num_render_jobs = 0;
+}
+
 void samure_context_update(struct samure_context *ctx, double delta_time) {
   if (ctx->cursor_engine) {
     samure_cursor_engine_update(ctx->cursor_engine, delta_time);
@@ -453,22 +1193,45 @@ samure_error
 samure_context_create_output_layer_surfaces(struct samure_context *ctx) {
   samure_error error_code = SAMURE_ERROR_NONE;
 
-  for (size_t i = 0; i < ctx->num_outputs; i++) {
-    struct samure_output *o = ctx->outputs[i];
+  struct samure_layer_surface **sfcs =
+      calloc(ctx->num_outputs, sizeof(struct samure_layer_surface *));
+  if (!sfcs && ctx->num_outputs != 0) {
+    return SAMURE_ERROR_MEMORY;
+  }
 
+  // Create the layer surfaces of all outputs and wait for all of their
+  // configure events in one roundtrip
+  for (size_t i = 0; i < ctx->num_outputs; i++) {
     SAMURE_RESULT(layer_surface)
-    sfc_rs = samure_create_layer_surface(
-        ctx, o, SAMURE_LAYER_OVERLAY, SAMURE_LAYER_SURFACE_ANCHOR_FILL,
+    sfc_rs = samure_begin_create_layer_surface(
+        ctx, ctx->outputs[i], SAMURE_LAYER_OVERLAY,
+        SAMURE_LAYER_SURFACE_ANCHOR_FILL,
         (uint32_t)ctx->config.keyboard_interaction,
-        ctx->config.pointer_interaction || ctx->config.touch_interaction, 1);
+        ctx->config.pointer_interaction || ctx->config.touch_interaction);
     if (SAMURE_HAS_ERROR(sfc_rs)) {
       error_code |= SAMURE_ERROR_LAYER_SURFACE_INIT | sfc_rs.error;
       continue;
     }
+    sfcs[i] = SAMURE_UNWRAP(layer_surface, sfc_rs);
+  }
+
+  wl_display_roundtrip(ctx->display);
+
+  for (size_t i = 0; i < ctx->num_outputs; i++) {
+    if (!sfcs[i]) {
+      continue;
+    }
+
+    const samure_error err = samure_end_create_layer_surface(ctx, sfcs[i], 1);
+    if (SAMURE_IS_ERROR(err)) {
+      error_code |= SAMURE_ERROR_LAYER_SURFACE_INIT | err;
+      continue;
+    }
 
-    samure_output_attach_layer_surface(o, SAMURE_UNWRAP(layer_surface, sfc_rs));
+    samure_output_attach_layer_surface(ctx->outputs[i], sfcs[i]);
   }
 
+  free(sfcs);
   return error_code;
 }
 
@@ -28,6 +28,7 @@
 
 #include "wayland/cursor-shape.h"
 #include "wayland/layer-shell.h"
+#include "wayland/presentation-time.h"
 #include "wayland/screencopy.h"
 #include "wayland/viewporter.h"
 #include "wayland/xdg-output.h"
@@ -39,9 +40,27 @@
 #include "events.h"
 #include "frame_timer.h"
 #include "output.h"
+#include "screencopy_stream.h"
 #include "seat.h"
+#include "worker_pool.h"
 
 #define SAMURE_NO_CONTEXT_CONFIG NULL
+// How many events fit into the event queue before it needs to grow. The
+// capacity doubles whenever it runs out
+#define SAMURE_NUM_PREALLOCATED_EVENTS 64
+
+// A layer surface that is rendered in parallel to others
+struct samure_render_job {
+  struct samure_layer_surface *sfc;
+  struct samure_rect geo;
+  double render_time; // How long on_render took in seconds
+};
+
+// A motion sample together with the index of the event it belongs to
+struct samure_event_motion_sample {
+  size_t event_index;
+  struct samure_motion_sample sample;
+};
 
 struct samure_context;
 struct samure_opengl_config;
@@ -66,6 +85,10 @@ typedef void (*samure_event_callback)(struct samure_context *ctx,
                                       struct samure_event *event,
                                       void *user_data);
 // public
+typedef void (*samure_events_callback)(struct samure_context *ctx,
+                                       struct samure_event *events,
+                                       size_t num_events, void *user_data);
+// public
 typedef void (*samure_render_callback)(
     struct samure_context *ctx, struct samure_layer_surface *layer_surface,
     struct samure_rect output_geo, void *user_data);
@@ -76,6 +99,7 @@ typedef void (*samure_update_callback)(struct samure_context *ctx,
 // public
 struct samure_app {
   samure_event_callback on_event;
+  samure_events_callback on_events;
   samure_render_callback on_render;
   samure_update_callback on_update;
 };
@@ -91,8 +115,42 @@ struct samure_context_config {
   int not_create_output_layer_surfaces;
   int not_request_frame;
   int force_client_cursors;
+  uint32_t num_buffers; // Number of buffers per layer surface of the raw and
+                        // cairo backends (1 - 3). Defaults to 1
+  enum samure_huge_pages huge_pages; // Page size of the shared memory arena
+  uint32_t num_worker_threads; // Number of threads of the worker pool that is
+                               // used for parallel copies and rendering. 0
+                               // disables it
+  int sleep_when_idle; // Block until an event arrives instead of calling
+                       // on_update while the render state is
+                       // SAMURE_RENDER_STATE_NONE
+  int render_deadline_scheduling; // Delay rendering of layer surfaces until
+                                  // just before the predicted next vblank
+                                  // (requires wp_presentation)
+  double render_deadline_margin;  // Time in seconds that a render should
+                                  // finish before the vblank. Defaults to
+                                  // SAMURE_DEFAULT_RENDER_DEADLINE_MARGIN
+  int coalesce_motion_events; // Merge consecutive POINTER_MOTION events of a
+                              // seat and TOUCH_MOTION events of a touch point
+                              // into one event per frame
+  int keep_motion_history; // Remember every coalesced motion event (see
+                           // samure_context_get_motion_samples)
+  int per_output_refresh; // Render every output at its own refresh rate
+                          // while the render state is ALWAYS.
+                          // max_update_frequency then only applies to
+                          // on_update and to outputs without a known rate
+  int parallel_rendering; // Call on_render for all layer surfaces of all
+                          // outputs in parallel on the worker pool (requires
+                          // num_worker_threads, ignored for backends without
+                          // thread_safe_rendering like opengl). on_render
+                          // must be thread safe and must not use the worker
+                          // pool
 
   samure_event_callback on_event;
+  samure_events_callback on_events; // Receives all events of a frame at once
+                                    // instead of on_event. The
+                                    // LAYER_SURFACE_CONFIGURE events have
+                                    // already been applied
   samure_render_callback on_render;
   samure_update_callback on_update;
 
@@ -110,12 +168,15 @@ samure_create_context_config(samure_event_callback event_callback,
 struct samure_context {
   struct wl_display *display;
   struct wl_shm *shm;
+  struct samure_shm_arena *shm_arena;
   struct wl_compositor *compositor;
   struct zwlr_layer_shell_v1 *layer_shell;
   struct zxdg_output_manager_v1 *output_manager;
   struct zwlr_screencopy_manager_v1 *screencopy_manager;
   struct wp_fractional_scale_manager_v1 *fractional_scale_manager;
   struct wp_viewporter *viewporter;
+  struct wp_presentation *presentation;
+  uint32_t presentation_clock_id; // The clock of the presentation timestamps
   struct samure_cursor_engine *cursor_engine;
 
   struct samure_seat **seats;
@@ -123,11 +184,29 @@ struct samure_context {
 
   struct samure_output **outputs;
   size_t num_outputs;
+  // Outputs that have been plugged in but whose properties are still unknown
+  struct samure_output **pending_outputs;
+  size_t num_pending_outputs;
+  struct wl_registry *registry;
+  // Screenshots of samure_output_screenshot_async that are not destroyed yet
+  struct samure_screenshot **screenshots;
+  size_t num_screenshots;
+  // Streams of samure_create_screencopy_stream
+  struct samure_screencopy_stream **screencopy_streams;
+  size_t num_screencopy_streams;
 
   struct samure_event *events;
   size_t num_events;
   size_t cap_events;
   size_t event_index;
+  struct samure_event_motion_sample *motion_samples;
+  size_t num_motion_samples;
+  size_t cap_motion_samples;
+  struct samure_render_job *render_jobs;
+  size_t num_render_jobs;
+  size_t cap_render_jobs;
+  int rendering_in_parallel; // Whether the render callbacks currently run on
+                             // the worker pool
   int running;
   enum samure_render_state render_state;
 
@@ -137,13 +216,17 @@ struct samure_context {
   struct samure_app app;
 
   struct samure_frame_timer frame_timer;
+  struct samure_worker_pool *worker_pool; // NULL if num_worker_threads is 0
   void *backend_lib_handle;
+  int wakeup_fd; // eventfd used by samure_context_wakeup
+  int unsent_requests; // Whether the last flush could not send all requests
+                       // because the socket buffer was full
 };
 
 struct samure_registry_data {
   struct wl_seat **seats;
   size_t num_seats;
-  struct wl_output **outputs;
+  struct samure_output **outputs;
   size_t num_outputs;
   struct wp_cursor_shape_manager_v1 *cursor_manager;
   samure_error error;
@@ -163,9 +246,49 @@ extern void samure_destroy_context(struct samure_context *ctx);
 // public
 extern void samure_context_run(struct samure_context *ctx);
 // public
+// Returns the file descriptor of the wayland connection. When it becomes
+// readable, or writable while samure_context_get_poll_events contains POLLOUT,
+// samure_context_step should be called. Can be used to integrate samure into
+// an external event loop instead of calling samure_context_run
+extern int samure_context_get_fd(struct samure_context *ctx);
+// public
+// Returns the poll events for which the file descriptor of
+// samure_context_get_fd needs to be watched. It is POLLIN and additionally
+// POLLOUT while not all requests could be sent because the socket buffer was
+// full. Needs to be queried again after every samure_context_step
+extern short samure_context_get_poll_events(struct samure_context *ctx);
+// public
+// Returns a file descriptor that becomes readable when samure_context_wakeup
+// has been called. samure_context_step should be called then
+extern int samure_context_get_wakeup_fd(struct samure_context *ctx);
+// public
+// Wakes up a context that is sleeping because it is idle (see
+// sleep_when_idle) so that on_update gets called. Can be called from any thread
+extern void samure_context_wakeup(struct samure_context *ctx);
+// public
+// Returns the time in milliseconds after which samure_context_step should be
+// called for the next frame. 0 means that a frame is due now and -1 that the
+// context is idle and only needs to be stepped when one of its file
+// descriptors becomes readable
+extern int samure_context_get_timeout(struct samure_context *ctx);
+// public
+// Dispatches the available events without blocking and updates and renders
+// if the next frame is due. Sets running to 0 if the connection to the
+// compositor has been lost
+extern void samure_context_step(struct samure_context *ctx);
+// public
 extern struct samure_rect
 samure_context_get_output_rect(struct samure_context *ctx);
 // public
+// Takes a screenshot of every output at once. buffers needs to have room for
+// num_outputs buffers. buffers[i] receives the screenshot of outputs[i] or
+// NULL if it failed, where the indices refer to the outputs present when the
+// function has been called. Returns the errors of all failed screenshots
+extern samure_error
+samure_context_screenshot_all(struct samure_context *ctx,
+                              struct samure_shared_buffer **buffers,
+                              int capture_cursor);
+// public
 extern void samure_context_set_pointer_interaction(struct samure_context *ctx,
                                                    int enable);
 // public
@@ -178,8 +301,35 @@ extern void samure_context_set_keyboard_interaction(struct samure_context *ctx,
                                                     int enable);
 
 // public
+// Dispatches all wayland events that have arrived so far without blocking and
+// passes them to the event callback or all at once to the events callback.
+// Stops the context if the connection to the compositor has been lost
 extern void samure_context_process_events(struct samure_context *ctx);
 
+// Appends a zeroed event to the event queue and returns it or NULL if there is
+// no memory for it
+extern struct samure_event *
+samure_context_new_event(struct samure_context *ctx);
+
+// Adds an output that has been bound after the context has been created. It
+// is announced as soon as all of its properties have arrived
+extern void samure_context_add_pending_output(struct samure_context *ctx,
+                                              struct samure_output *output);
+
+// Removes the output of the wl_output global with the given name and sends
+// SAMURE_EVENT_OUTPUT_REMOVED
+extern void samure_context_remove_output(struct samure_context *ctx,
+                                         uint32_t registry_name);
+
+// public
+// Writes up to max_samples of the motion events that have been coalesced into
+// the POINTER_MOTION or TOUCH_MOTION event e into samples in the order they
+// arrived and returns how many have been written. Requires
+// keep_motion_history and is only valid inside the event callbacks
+extern size_t samure_context_get_motion_samples(
+    struct samure_context *ctx, const struct samure_event *e,
+    struct samure_motion_sample *samples, size_t max_samples);
+
 // public
 extern void
 samure_context_render_layer_surface(struct samure_context *ctx,
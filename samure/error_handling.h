@@ -133,8 +133,9 @@
 #define SAMURE_ERROR_PROTOCOL_VERSION ((samure_error)1 << 36)
 #define SAMURE_ERROR_NO_DEPEND_LIB ((samure_error)1 << 37)
 #define SAMURE_ERROR_NO_LIB ((samure_error)1 << 38)
+#define SAMURE_ERROR_WORKER_POOL_INIT ((samure_error)1 << 39)
 
-#define SAMURE_NUM_ERRORS 39
+#define SAMURE_NUM_ERRORS 40
 
 #ifndef NDEBUG
 #define DEBUG_PRINTF(format, ...)                                              \
@@ -192,6 +193,7 @@ static const char *samure_strerror(samure_error error_code) {
   case SAMURE_ERROR_PROTOCOL_VERSION:          return "required protocol version not matched";
   case SAMURE_ERROR_NO_DEPEND_LIB:             return "dependent library failed to load";
   case SAMURE_ERROR_NO_LIB:                    return "library failed to load";
+  case SAMURE_ERROR_WORKER_POOL_INIT:          return "worker thread creation failed";
   default:                                     return "unknown error";
   }
   // clang-format on
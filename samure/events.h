@@ -41,11 +41,39 @@ enum samure_event_type {
   SAMURE_EVENT_TOUCH_DOWN,
   SAMURE_EVENT_TOUCH_UP,
   SAMURE_EVENT_TOUCH_MOTION,
+  SAMURE_EVENT_POINTER_FRAME, // Ends a group of pointer events of a seat that
+                              // belong together
+  SAMURE_EVENT_TOUCH_FRAME,   // Ends a group of touch events of a seat that
+                              // belong together
+  SAMURE_EVENT_OUTPUT_ADDED,   // An output has been plugged in. Its layer
+                               // surfaces have already been created
+  SAMURE_EVENT_OUTPUT_REMOVED, // An output has been unplugged. It and its
+                               // layer surfaces are destroyed after the event
+                               // callbacks returned
+  SAMURE_EVENT_SCREENSHOT_READY,  // A screenshot of
+                                  // samure_output_screenshot_async is done
+  SAMURE_EVENT_SCREENSHOT_FAILED, // A screenshot of
+                                  // samure_output_screenshot_async failed
+  SAMURE_EVENT_SCREENCOPY_FRAME,  // A screencopy stream captured a new frame
+  SAMURE_EVENT_SCREENCOPY_FAILED, // A screencopy stream stopped capturing
 };
 
 struct samure_seat;
 struct samure_output;
 struct samure_layer_surface;
+struct samure_screenshot;
+struct samure_shared_buffer;
+struct samure_screencopy_stream;
+struct samure_screencopy_frame;
+
+// public
+// A single motion event that has been coalesced into a POINTER_MOTION or
+// TOUCH_MOTION event
+struct samure_motion_sample {
+  double x;
+  double y;
+  uint32_t time; // Timestamp of the compositor in milliseconds
+};
 
 // public
 struct samure_event {
@@ -53,11 +81,40 @@ struct samure_event {
   struct samure_seat *seat;
   struct samure_output *output;
   struct samure_layer_surface *surface;
-  uint32_t button;
-  uint32_t state;
-  uint32_t width;
-  uint32_t height;
-  double x;
-  double y;
-  int32_t touch_id;
+  // Only the members of the respective event type are valid
+  union {
+    // POINTER_MOTION, POINTER_ENTER, TOUCH_DOWN, TOUCH_MOTION, TOUCH_UP
+    struct {
+      double x;
+      double y;
+      int32_t touch_id;
+      uint32_t num_samples; // Number of motion events that have been
+                            // coalesced into this one (see
+                            // coalesce_motion_events)
+    };
+    // POINTER_BUTTON, KEYBOARD_KEY
+    struct {
+      uint32_t button;
+      uint32_t state;
+    };
+    // LAYER_SURFACE_CONFIGURE
+    struct {
+      uint32_t width;
+      uint32_t height;
+    };
+    // SCREENSHOT_READY, SCREENSHOT_FAILED
+    struct {
+      // Destroyed after the event callbacks returned
+      struct samure_screenshot *screenshot;
+      // The captured image of SCREENSHOT_READY. It belongs to the application
+      // which needs to destroy it with samure_destroy_shared_buffer
+      struct samure_shared_buffer *buffer;
+    };
+    // SCREENCOPY_FRAME, SCREENCOPY_FAILED
+    struct {
+      struct samure_screencopy_stream *screencopy_stream;
+      // The captured frame of SCREENCOPY_FRAME. It belongs to the stream
+      struct samure_screencopy_frame *screencopy_frame;
+    };
+  };
 };
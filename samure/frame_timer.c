@@ -25,6 +25,7 @@
  ************************************************************************************/
 
 #include "frame_timer.h"
+#include <errno.h>
 #include <stdio.h>
 #include <time.h>
 #include <unistd.h>
@@ -44,32 +45,79 @@ struct samure_frame_timer samure_init_frame_timer(uint32_t max_fps) {
   return f;
 }
 
-void samure_frame_timer_start_frame(struct samure_frame_timer *f) {
-  f->start_time = samure_get_time();
+static void
+samure_frame_timer_store_raw_delta_time(struct samure_frame_timer *f);
+
+static void samure_frame_timer_store_jitter(struct samure_frame_timer *f,
+                                            double jitter) {
+  f->jitter = jitter;
+  f->jitters[f->current_jitters_index] = jitter;
+  f->current_jitters_index =
+      (f->current_jitters_index + 1) % SAMURE_NUM_MEASURES;
+  if (f->num_jitters < SAMURE_NUM_MEASURES)
+    f->num_jitters++;
+
+  f->mean_jitter = 0.0;
+  f->max_jitter = 0.0;
+  for (size_t i = 0; i < f->num_jitters; i++) {
+    f->mean_jitter += f->jitters[i];
+    if (f->jitters[i] > f->max_jitter) {
+      f->max_jitter = f->jitters[i];
+    }
+  }
+  f->mean_jitter /= (double)f->num_jitters;
 }
 
-void samure_frame_timer_end_frame(struct samure_frame_timer *f) {
-  const double end_time = samure_get_time();
-  f->raw_delta_time = end_time - f->start_time;
+void samure_frame_timer_tick(struct samure_frame_timer *f) {
+  const double now = samure_get_time();
+  const double period = 1.0 / (double)f->max_update_frequency;
 
-  // Limit FPS
-  const double max_delta_time = 1.0 / (double)f->max_update_frequency;
-  if (f->raw_delta_time < max_delta_time) {
-    const double max_sleep_time = max_delta_time - f->raw_delta_time;
+  if (f->start_time == 0.0) {
+    f->raw_delta_time = period;
+    f->next_frame_time = now;
+  } else {
+    f->raw_delta_time = now - f->start_time;
+  }
+  f->start_time = now;
 
-    const double sleep_start_time = samure_get_time();
+  samure_frame_timer_store_jitter(f, now - f->next_frame_time);
 
-    const useconds_t sleep_time =
-        (useconds_t)(max_sleep_time * 1000.0 * 1000.0);
-    usleep(sleep_time);
+  // Advance the deadline by exactly one period so that oversleeping does not
+  // accumulate. If we fell behind by more than a period skip the missed
+  // frames instead of rendering them in a burst
+  f->next_frame_time += period;
+  if (f->next_frame_time < now) {
+    f->next_frame_time = now + period;
+  }
 
-    const double sleep_end_time = samure_get_time();
+  samure_frame_timer_store_raw_delta_time(f);
+}
 
-    const double slept_time = sleep_end_time - sleep_start_time;
+void samure_frame_timer_start_frame(struct samure_frame_timer *f) {
+  samure_frame_timer_tick(f);
+}
 
-    f->raw_delta_time += slept_time;
+void samure_frame_timer_end_frame(struct samure_frame_timer *f) {
+  samure_frame_timer_sleep(f);
+}
+
+double samure_frame_timer_get_timeout(struct samure_frame_timer *f) {
+  if (f->start_time == 0.0) {
+    return 0.0;
+  }
+
+  const double timeout = f->next_frame_time - samure_get_time();
+  return timeout > 0.0 ? timeout : 0.0;
+}
+
+void samure_frame_timer_sleep(struct samure_frame_timer *f) {
+  if (f->start_time != 0.0) {
+    samure_sleep_until(f->next_frame_time);
   }
+}
 
+static void
+samure_frame_timer_store_raw_delta_time(struct samure_frame_timer *f) {
   // Store raw delta time
   f->raw_delta_times[f->current_raw_delta_times_index] = f->raw_delta_time;
   f->smoothed_delta_times[f->current_raw_delta_times_index] = f->raw_delta_time;
@@ -131,7 +179,21 @@ void samure_frame_timer_end_frame(struct samure_frame_timer *f) {
 
 double samure_get_time() {
   struct timespec tp;
-  clock_gettime(CLOCK_REALTIME, &tp);
-  return (double)(tp.tv_sec * (1000 * 1000 * 1000) + tp.tv_nsec) /
-         (1000.0 * 1000.0 * 1000.0);
+  clock_gettime(CLOCK_MONOTONIC, &tp);
+  return (double)tp.tv_sec + (double)tp.tv_nsec / (1000.0 * 1000.0 * 1000.0);
+}
+
+void samure_sleep_until(double time) {
+  struct timespec tp;
+  tp.tv_sec = (time_t)time;
+  tp.tv_nsec = (long)((time - (double)tp.tv_sec) * 1000.0 * 1000.0 * 1000.0);
+  if (tp.tv_nsec >= 1000 * 1000 * 1000) {
+    tp.tv_sec++;
+    tp.tv_nsec -= 1000 * 1000 * 1000;
+  }
+
+  // Sleeping until an absolute deadline does not drift when we get woken up
+  // late or interrupted by a signal
+  while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &tp, NULL) == EINTR)
+    ;
 }
@@ -46,9 +46,31 @@ struct samure_frame_timer {
   size_t num_raw_delta_times;
   double mean_delta_time;
   double smoothed_delta_times[SAMURE_NUM_MEASURES];
+
+  double next_frame_time; // Absolute deadline of the next frame
+  double jitter;          // How many seconds the last frame started too late
+  double mean_jitter;     // Mean jitter of the last SAMURE_NUM_MEASURES frames
+  double max_jitter;      // Max jitter of the last SAMURE_NUM_MEASURES frames
+  double jitters[SAMURE_NUM_MEASURES];
+  size_t current_jitters_index;
+  size_t num_jitters;
 };
 
 extern struct samure_frame_timer samure_init_frame_timer(uint32_t max_fps);
+// Starts a new frame like samure_frame_timer_tick
 extern void samure_frame_timer_start_frame(struct samure_frame_timer *f);
+// Sleeps until the next frame is due like samure_frame_timer_sleep. The
+// deadlines are absolute, so oversleeping does not accumulate
 extern void samure_frame_timer_end_frame(struct samure_frame_timer *f);
+// Starts a new frame and measures the time since the last tick without
+// sleeping
+extern void samure_frame_timer_tick(struct samure_frame_timer *f);
+// Returns the time in seconds until the next frame is due or 0 if it is
+// already due
+extern double samure_frame_timer_get_timeout(struct samure_frame_timer *f);
+// Sleeps until the next frame is due
+extern void samure_frame_timer_sleep(struct samure_frame_timer *f);
+// Returns the time of CLOCK_MONOTONIC in seconds
 extern double samure_get_time();
+// Sleeps until samure_get_time returns time
+extern void samure_sleep_until(double time);
@@ -28,11 +28,16 @@
 #include "callbacks.h"
 #include "context.h"
 #include "wayland/fractional-scale.h"
+#include "wayland/presentation-time.h"
 #include "wayland/viewporter.h"
 #include <assert.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
+
+// Identifies the wl_surfaces of layer surfaces
+static const char *const samure_layer_surface_tag = "samure_layer_surface";
 
 #define SAMURE_LAYER_SURFACE_DESTROY_ERROR(error_code)                         \
   {                                                                            \
@@ -47,6 +52,31 @@ samure_create_layer_surface(struct samure_context *ctx, struct samure_output *o,
                             uint32_t layer, uint32_t anchor,
                             int keyboard_interaction, int pointer_interaction,
                             int backend_association) {
+  SAMURE_RESULT(layer_surface)
+  s_rs = samure_begin_create_layer_surface(ctx, o, layer, anchor,
+                                           keyboard_interaction,
+                                           pointer_interaction);
+  if (SAMURE_HAS_ERROR(s_rs)) {
+    return s_rs;
+  }
+  struct samure_layer_surface *s = SAMURE_UNWRAP(layer_surface, s_rs);
+
+  wl_display_roundtrip(ctx->display);
+
+  const samure_error err =
+      samure_end_create_layer_surface(ctx, s, backend_association);
+  if (SAMURE_IS_ERROR(err)) {
+    SAMURE_RETURN_ERROR(layer_surface, err);
+  }
+
+  SAMURE_RETURN_RESULT(layer_surface, s);
+}
+
+SAMURE_RESULT(layer_surface)
+samure_begin_create_layer_surface(struct samure_context *ctx,
+                                  struct samure_output *o, uint32_t layer,
+                                  uint32_t anchor, int keyboard_interaction,
+                                  int pointer_interaction) {
   SAMURE_RESULT_ALLOC(layer_surface, s);
 
   s->preferred_buffer_scale = 1;
@@ -61,6 +91,7 @@ samure_create_layer_surface(struct samure_context *ctx, struct samure_output *o,
   if (!s->surface) {
     SAMURE_LAYER_SURFACE_DESTROY_ERROR(SAMURE_ERROR_SURFACE_INIT);
   }
+  wl_proxy_set_tag((struct wl_proxy *)s->surface, &samure_layer_surface_tag);
 
   s->layer_surface = zwlr_layer_shell_v1_get_layer_surface(
       ctx->layer_shell, s->surface, o ? o->output : NULL, layer,
@@ -106,8 +137,14 @@ samure_create_layer_surface(struct samure_context *ctx, struct samure_output *o,
 
   wl_surface_add_listener(s->surface, &surface_listener, s->callback_data);
   wl_surface_commit(s->surface);
-  wl_display_roundtrip(ctx->display);
 
+  SAMURE_RETURN_RESULT(layer_surface, s);
+}
+
+samure_error
+samure_end_create_layer_surface(struct samure_context *ctx,
+                                struct samure_layer_surface *s,
+                                int backend_association) {
   if (!s->fractional_scale) {
     s->scale = (double)s->preferred_buffer_scale;
     if (!s->viewport) {
@@ -120,13 +157,14 @@ samure_create_layer_surface(struct samure_context *ctx, struct samure_output *o,
       ctx->backend->associate_layer_surface) {
     const samure_error err = ctx->backend->associate_layer_surface(ctx, s);
     if (SAMURE_IS_ERROR(err)) {
-      SAMURE_LAYER_SURFACE_DESTROY_ERROR(err);
+      samure_destroy_layer_surface(ctx, s);
+      return err;
     }
   }
 
   s->frame_start_time = samure_get_time();
 
-  SAMURE_RETURN_RESULT(layer_surface, s);
+  return SAMURE_ERROR_NONE;
 }
 
 void samure_destroy_layer_surface(struct samure_context *ctx,
@@ -135,6 +173,15 @@ void samure_destroy_layer_surface(struct samure_context *ctx,
     ctx->backend->unassociate_layer_surface(ctx, sfc);
   }
 
+  for (size_t i = 0; i < sfc->num_pending_feedbacks; i++) {
+    wp_presentation_feedback_destroy(sfc->pending_feedbacks[i].feedback);
+  }
+
+  if (sfc->frame_callback) {
+    free(wl_callback_get_user_data(sfc->frame_callback));
+    wl_callback_destroy(sfc->frame_callback);
+  }
+
   if (sfc->layer_surface)
     zwlr_layer_surface_v1_destroy(sfc->layer_surface);
   if (sfc->fractional_scale)
@@ -151,7 +198,34 @@ void samure_destroy_layer_surface(struct samure_context *ctx,
 void samure_layer_surface_draw_buffer(struct samure_layer_surface *sfc,
                                       struct samure_shared_buffer *buf) {
   wl_surface_attach(sfc->surface, buf->buffer, 0, 0);
-  wl_surface_damage_buffer(sfc->surface, 0, 0, buf->width, buf->height);
+  buf->busy = 1;
+
+  const struct samure_rect buffer_rect = {
+      .x = 0, .y = 0, .w = buf->width, .h = buf->height};
+  struct samure_rect frame_damage = {0};
+
+  if (sfc->num_damage == 0) {
+    wl_surface_damage_buffer(sfc->surface, 0, 0, buf->width, buf->height);
+    frame_damage = buffer_rect;
+  } else {
+    for (size_t i = 0; i < sfc->num_damage; i++) {
+      const struct samure_rect r =
+          samure_rect_intersection(sfc->damage[i], buffer_rect);
+      if (r.w > 0 && r.h > 0) {
+        wl_surface_damage_buffer(sfc->surface, r.x, r.y, r.w, r.h);
+        frame_damage = samure_rect_union(frame_damage, r);
+      }
+    }
+    sfc->num_damage = 0;
+  }
+
+  sfc->damage_history_index =
+      (sfc->damage_history_index + 1) % SAMURE_DAMAGE_HISTORY_SIZE;
+  sfc->damage_history[sfc->damage_history_index] = frame_damage;
+  if (sfc->num_damage_history < SAMURE_DAMAGE_HISTORY_SIZE) {
+    sfc->num_damage_history++;
+  }
+
   if (sfc->viewport) {
     wp_viewport_set_destination(sfc->viewport, sfc->w, sfc->h);
     wp_viewport_set_source(sfc->viewport, 0, 0, wl_fixed_from_int(buf->width),
@@ -160,6 +234,183 @@ void samure_layer_surface_draw_buffer(struct samure_layer_surface *sfc,
   wl_surface_commit(sfc->surface);
 }
 
+void samure_layer_surface_damage(struct samure_layer_surface *sfc,
+                                 struct samure_rect damage) {
+  if (damage.w <= 0 || damage.h <= 0) {
+    return;
+  }
+
+  if (sfc->num_damage == SAMURE_MAX_DAMAGE_RECTS) {
+    for (size_t i = 1; i < sfc->num_damage; i++) {
+      damage = samure_rect_union(damage, sfc->damage[i]);
+    }
+    sfc->damage[0] = samure_rect_union(damage, sfc->damage[0]);
+    sfc->num_damage = 1;
+    return;
+  }
+
+  sfc->damage[sfc->num_damage] = damage;
+  sfc->num_damage++;
+}
+
+struct samure_rect
+samure_layer_surface_get_buffer_damage(struct samure_layer_surface *sfc,
+                                       uint64_t buffer_age) {
+  const uint32_t scaled_width = RENDER_SCALE(sfc->w);
+  const uint32_t scaled_height = RENDER_SCALE(sfc->h);
+  const struct samure_rect buffer_rect = {
+      .x = 0,
+      .y = 0,
+      .w = scaled_width == 0 ? 1 : scaled_width,
+      .h = scaled_height == 0 ? 1 : scaled_height,
+  };
+
+  // A buffer of age n misses the damage of the last n-1 frames
+  if (buffer_age == 0 || buffer_age - 1 > sfc->num_damage_history) {
+    return buffer_rect;
+  }
+
+  struct samure_rect damage = {0};
+  for (uint64_t i = 0; i < buffer_age - 1; i++) {
+    const size_t index =
+        (sfc->damage_history_index + SAMURE_DAMAGE_HISTORY_SIZE - i) %
+        SAMURE_DAMAGE_HISTORY_SIZE;
+    damage = samure_rect_union(damage, sfc->damage_history[index]);
+  }
+
+  return samure_rect_intersection(damage, buffer_rect);
+}
+
+void samure_layer_surface_request_presentation_feedback(
+    struct samure_context *ctx, struct samure_layer_surface *sfc) {
+  if (!ctx->presentation ||
+      sfc->num_pending_feedbacks == SAMURE_MAX_PENDING_PRESENTATION_FEEDBACKS) {
+    return;
+  }
+
+  struct wp_presentation_feedback *feedback =
+      wp_presentation_feedback(ctx->presentation, sfc->surface);
+  if (!feedback) {
+    return;
+  }
+  wp_presentation_feedback_add_listener(feedback,
+                                        &presentation_feedback_listener, sfc);
+
+  struct timespec tp;
+  clock_gettime((clockid_t)ctx->presentation_clock_id, &tp);
+
+  struct samure_presentation_feedback *f =
+      &sfc->pending_feedbacks[sfc->num_pending_feedbacks];
+  f->feedback = feedback;
+  f->commit_time =
+      (double)tp.tv_sec + (double)tp.tv_nsec / (1000.0 * 1000.0 * 1000.0);
+  sfc->num_pending_feedbacks++;
+}
+
+void samure_layer_surface_finish_presentation_feedback(
+    struct samure_layer_surface *sfc,
+    struct wp_presentation_feedback *feedback, int presented,
+    double presented_time, double refresh, uint64_t seq, uint32_t flags) {
+  size_t index = 0;
+  for (; index < sfc->num_pending_feedbacks; index++) {
+    if (sfc->pending_feedbacks[index].feedback == feedback) {
+      break;
+    }
+  }
+  if (index == sfc->num_pending_feedbacks) {
+    return;
+  }
+
+  const double commit_time = sfc->pending_feedbacks[index].commit_time;
+  sfc->pending_feedbacks[index] =
+      sfc->pending_feedbacks[sfc->num_pending_feedbacks - 1];
+  sfc->num_pending_feedbacks--;
+
+  struct samure_presentation_stats *s = &sfc->presentation;
+  if (!presented) {
+    s->num_discarded++;
+    return;
+  }
+
+  s->presented_time = presented_time;
+  s->refresh = refresh;
+  s->seq = seq;
+  s->flags = flags;
+  s->latency = presented_time - commit_time;
+  if (s->num_presented == 0) {
+    s->mean_latency = s->latency;
+  } else {
+    s->mean_latency += (s->latency - s->mean_latency) / 16.0;
+  }
+  s->num_presented++;
+}
+
+struct samure_layer_surface *
+samure_layer_surface_from_surface(struct wl_surface *surface) {
+  // The tag makes sure that the user data is a samure_callback_data
+  if (!surface || wl_proxy_get_tag((struct wl_proxy *)surface) !=
+                      &samure_layer_surface_tag) {
+    return NULL;
+  }
+
+  struct samure_callback_data *d =
+      (struct samure_callback_data *)wl_surface_get_user_data(surface);
+  return d ? (struct samure_layer_surface *)d->data : NULL;
+}
+
+void samure_layer_surface_store_render_cost(struct samure_layer_surface *sfc,
+                                            double render_cost) {
+  sfc->render_costs[sfc->render_costs_index] = render_cost;
+  sfc->render_costs_index =
+      (sfc->render_costs_index + 1) % SAMURE_NUM_RENDER_COSTS;
+  if (sfc->num_render_costs < SAMURE_NUM_RENDER_COSTS) {
+    sfc->num_render_costs++;
+  }
+}
+
+double
+samure_layer_surface_get_render_start_time(struct samure_layer_surface *sfc,
+                                           uint32_t presentation_clock_id,
+                                           double margin) {
+  const struct samure_presentation_stats *p = &sfc->presentation;
+  if (p->num_presented == 0 || p->refresh <= 0.0) {
+    return 0.0;
+  }
+
+  // Be pessimistic and expect the render to take as long as the longest one
+  double cost = 0.0;
+  for (size_t i = 0; i < sfc->num_render_costs; i++) {
+    if (sfc->render_costs[i] > cost) {
+      cost = sfc->render_costs[i];
+    }
+  }
+  cost += margin;
+
+  // The presentation timestamps might use a different clock than
+  // samure_get_time
+  struct timespec tp;
+  clock_gettime((clockid_t)presentation_clock_id, &tp);
+  const double now = samure_get_time();
+  const double clock_offset =
+      (double)tp.tv_sec + (double)tp.tv_nsec / (1000.0 * 1000.0 * 1000.0) -
+      now;
+
+  // Find the first vblank that can still be made
+  const double earliest_vblank = now + clock_offset + cost;
+  if (earliest_vblank <= p->presented_time) {
+    return p->presented_time - cost - clock_offset;
+  }
+
+  const double refreshes = (earliest_vblank - p->presented_time) / p->refresh;
+  uint64_t num_refreshes = (uint64_t)refreshes;
+  if ((double)num_refreshes < refreshes) {
+    num_refreshes++;
+  }
+
+  const double vblank = p->presented_time + (double)num_refreshes * p->refresh;
+  return vblank - cost - clock_offset;
+}
+
 void samure_layer_surface_request_frame(struct samure_context *ctx,
                                         struct samure_layer_surface *sfc,
                                         struct samure_rect geo) {
@@ -167,8 +418,8 @@ void samure_layer_surface_request_frame(struct samure_context *ctx,
     return;
   }
 
-  struct wl_callback *cb = wl_surface_frame(sfc->surface);
-  wl_callback_add_listener(cb, &frame_listener,
+  sfc->frame_callback = wl_surface_frame(sfc->surface);
+  wl_callback_add_listener(sfc->frame_callback, &frame_listener,
                            samure_create_frame_data(ctx, geo, sfc));
   sfc->not_ready = 1;
 }
@@ -189,6 +440,13 @@ samure_create_shared_buffer_for_layer_surface(
     samure_destroy_shared_buffer(old_buffer);
   }
 
+  if (ctx->shm_arena) {
+    return samure_shm_arena_create_buffer(
+        ctx->shm_arena, SAMURE_BUFFER_FORMAT,
+        scaled_width == 0 ? 1 : scaled_width,
+        scaled_height == 0 ? 1 : scaled_height);
+  }
+
   return samure_create_shared_buffer(ctx->shm, SAMURE_BUFFER_FORMAT,
                                      scaled_width == 0 ? 1 : scaled_width,
                                      scaled_height == 0 ? 1 : scaled_height);
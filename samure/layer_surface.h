@@ -40,14 +40,51 @@
 #define SAMURE_LAYER_TOP ZWLR_LAYER_SHELL_V1_LAYER_TOP
 #define SAMURE_LAYER_OVERLAY ZWLR_LAYER_SHELL_V1_LAYER_OVERLAY
 
+// If more damage rectangles are reported during one frame they are merged
+// into their bounding box
+#define SAMURE_MAX_DAMAGE_RECTS 32
+// How many frames of damage are remembered for partial redraws
+#define SAMURE_DAMAGE_HISTORY_SIZE 4
+// How many presentation feedbacks can be in flight per layer surface
+#define SAMURE_MAX_PENDING_PRESENTATION_FEEDBACKS 4
+// How many render durations are remembered to predict the next one
+#define SAMURE_NUM_RENDER_COSTS 16
+// public
+#define SAMURE_DEFAULT_RENDER_DEADLINE_MARGIN 0.002
+
 struct samure_context;
 struct samure_output;
 struct zwlr_layer_surface_v1;
 struct wp_fractional_scale_v1;
 struct wp_viewport;
+struct wp_presentation_feedback;
+
+// public
+// Statistics about when the frames of a layer surface have been displayed.
+// Only available if the compositor supports wp_presentation. All times are
+// in seconds of the presentation clock (see presentation_clock_id of
+// samure_context)
+struct samure_presentation_stats {
+  uint64_t num_presented; // Number of frames that have been displayed
+  uint64_t num_discarded; // Number of frames that have never been displayed
+  double presented_time;  // When the last frame turned into light
+  double refresh; // Duration of one refresh cycle of the output or 0 if the
+                  // refresh rate is not constant
+  uint64_t seq;   // Vertical retrace counter of the output for the last frame
+  uint32_t flags; // WP_PRESENTATION_FEEDBACK_KIND_* of the last frame
+  double latency; // Time between the commit and the presentation of the last
+                  // frame
+  double mean_latency; // Exponential moving average of latency
+};
+
+struct samure_presentation_feedback {
+  struct wp_presentation_feedback *feedback;
+  double commit_time;
+};
 
 // public
 struct samure_layer_surface {
+  struct samure_output *output; // The output this layer surface is attached to
   struct wl_surface *surface;
   struct zwlr_layer_surface_v1 *layer_surface;
   struct wp_fractional_scale_v1 *fractional_scale;
@@ -60,12 +97,39 @@ struct samure_layer_surface {
   struct samure_callback_data *callback_data;
   int not_ready;
   int dirty;
+  int no_buffer; // Set by the backend in render_start if there is no free
+                 // buffer to render into. The render is retried when the
+                 // compositor releases a buffer
+  struct wl_callback *frame_callback; // The pending frame callback or NULL
   int configured;
+  int pending_creation; // Created with samure_begin_create_layer_surface and
+                        // finished when the first configure is processed
 
   double frame_start_time; // Absolute time of the last frame (for internal use)
   double frame_delta_time; // The actual time that passes between each call to
                            // samure_context_render_layer_surface in seconds
   double scale;
+
+  // Damaged regions of the next frame in buffer coordinates
+  struct samure_rect damage[SAMURE_MAX_DAMAGE_RECTS];
+  size_t num_damage;
+  // Bounding boxes of the damage of the last presented frames in buffer
+  // coordinates, damage_history[damage_history_index] is the newest one
+  struct samure_rect damage_history[SAMURE_DAMAGE_HISTORY_SIZE];
+  size_t damage_history_index;
+  size_t num_damage_history;
+
+  struct samure_presentation_stats presentation;
+  struct samure_presentation_feedback
+      pending_feedbacks[SAMURE_MAX_PENDING_PRESENTATION_FEEDBACKS];
+  size_t num_pending_feedbacks;
+
+  double render_at; // Absolute time at which a deferred render starts or 0
+  struct samure_rect render_geo; // Output geometry of the deferred render
+  double render_costs[SAMURE_NUM_RENDER_COSTS]; // Durations of the last
+                                                // renders in seconds
+  size_t render_costs_index;
+  size_t num_render_costs;
 };
 
 SAMURE_DEFINE_RESULT(layer_surface);
@@ -78,6 +142,20 @@ extern SAMURE_RESULT(layer_surface)
                                 int pointer_interaction,
                                 int backend_association);
 
+// Sends all requests to create a layer surface without waiting for the
+// compositor. samure_end_create_layer_surface needs to be called after the
+// next roundtrip. This way many layer surfaces can be created with one
+// roundtrip
+extern SAMURE_RESULT(layer_surface) samure_begin_create_layer_surface(
+    struct samure_context *ctx, struct samure_output *output, uint32_t layer,
+    uint32_t anchor, int keyboard_interaction, int pointer_interaction);
+// Finishes the creation of a layer surface after the first configure and
+// scale events have arrived. Destroys the layer surface on failure
+extern samure_error
+samure_end_create_layer_surface(struct samure_context *ctx,
+                                struct samure_layer_surface *layer_surface,
+                                int backend_association);
+
 // public
 extern void samure_destroy_layer_surface(struct samure_context *ctx,
                                          struct samure_layer_surface *sfc);
@@ -86,6 +164,52 @@ extern void samure_destroy_layer_surface(struct samure_context *ctx,
 extern void samure_layer_surface_draw_buffer(struct samure_layer_surface *sfc,
                                              struct samure_shared_buffer *buf);
 
+// public
+// Reports a damaged region of the next frame in buffer coordinates (see
+// RENDER_X, RENDER_Y and RENDER_SCALE). Only the damaged regions are submitted
+// to the compositor. If nothing is reported the whole buffer is damaged
+extern void samure_layer_surface_damage(struct samure_layer_surface *sfc,
+                                        struct samure_rect damage);
+
+// public
+// Returns the region that needs to be redrawn in a buffer of the given age (see
+// buffer_age of samure_raw_surface and samure_cairo_surface) to bring it up to
+// date with the last presented frame. The damage of the frame that is
+// currently being rendered is not included. The whole buffer is returned if
+// the age is 0 or older than the remembered history
+extern struct samure_rect
+samure_layer_surface_get_buffer_damage(struct samure_layer_surface *sfc,
+                                       uint64_t buffer_age);
+
+// Requests presentation feedback for the next commit of the layer surface
+extern void samure_layer_surface_request_presentation_feedback(
+    struct samure_context *ctx, struct samure_layer_surface *sfc);
+
+// Updates the presentation statistics with the result of a feedback and
+// removes it from the pending feedbacks
+extern void samure_layer_surface_finish_presentation_feedback(
+    struct samure_layer_surface *sfc,
+    struct wp_presentation_feedback *feedback, int presented,
+    double presented_time, double refresh, uint64_t seq, uint32_t flags);
+
+// Returns the layer surface that surface belongs to or NULL if surface has not
+// been created by samure_create_layer_surface
+extern struct samure_layer_surface *
+samure_layer_surface_from_surface(struct wl_surface *surface);
+
+// Remembers how long rendering a frame took
+extern void samure_layer_surface_store_render_cost(
+    struct samure_layer_surface *sfc, double render_cost);
+
+// Returns the latest time (see samure_get_time) at which rendering has to
+// start to make the next vblank. The longest of the last render durations and
+// margin are subtracted from the predicted vblank. Returns 0 if no vblank can
+// be predicted
+extern double
+samure_layer_surface_get_render_start_time(struct samure_layer_surface *sfc,
+                                           uint32_t presentation_clock_id,
+                                           double margin);
+
 extern void samure_layer_surface_request_frame(struct samure_context *ctx,
                                                struct samure_layer_surface *sfc,
                                                struct samure_rect geo);
@@ -29,26 +29,35 @@
 #include "context.h"
 #include <assert.h>
 #include <stdlib.h>
+#include <string.h>
 
 SAMURE_DEFINE_RESULT_UNWRAP(output);
+SAMURE_DEFINE_RESULT_UNWRAP(screenshot);
 
 SAMURE_RESULT(output)
 samure_create_output(struct samure_context *ctx, struct wl_output *output) {
   SAMURE_RESULT_ALLOC(output, o);
 
   o->output = output;
-  if (ctx->output_manager) {
-    o->xdg_output =
-        zxdg_output_manager_v1_get_xdg_output(ctx->output_manager, o->output);
-    if (o->xdg_output) {
-      zxdg_output_v1_add_listener(o->xdg_output, &xdg_output_listener, o);
-    }
-  }
-  wl_display_roundtrip(ctx->display);
+  wl_output_add_listener(o->output, &output_listener, o);
+  samure_output_create_xdg_output(ctx, o);
 
   SAMURE_RETURN_RESULT(output, o);
 }
 
+void samure_output_create_xdg_output(struct samure_context *ctx,
+                                     struct samure_output *o) {
+  if (o->xdg_output || !ctx->output_manager) {
+    return;
+  }
+
+  o->xdg_output =
+      zxdg_output_manager_v1_get_xdg_output(ctx->output_manager, o->output);
+  if (o->xdg_output) {
+    zxdg_output_v1_add_listener(o->xdg_output, &xdg_output_listener, o);
+  }
+}
+
 void samure_destroy_output(struct samure_context *ctx,
                            struct samure_output *o) {
   free(o->name);
@@ -56,6 +65,17 @@ void samure_destroy_output(struct samure_context *ctx,
     samure_destroy_layer_surface(ctx, o->sfc[i]);
   }
   free(o->sfc);
+  // Screenshots of the output that are still in flight outlive it
+  for (size_t i = 0; i < ctx->num_screenshots; i++) {
+    if (ctx->screenshots[i]->data.output == o) {
+      ctx->screenshots[i]->data.output = NULL;
+    }
+  }
+  for (size_t i = 0; i < ctx->num_screencopy_streams; i++) {
+    if (ctx->screencopy_streams[i]->output == o) {
+      samure_screencopy_stream_stop(ctx->screencopy_streams[i]);
+    }
+  }
   if (o->xdg_output)
     zxdg_output_v1_destroy(o->xdg_output);
   if (o->output)
@@ -121,6 +141,20 @@ void samure_output_attach_layer_surface(struct samure_output *o,
     return;
   }
   o->sfc[o->num_sfc - 1] = sfc;
+  sfc->output = o;
+}
+
+void samure_output_detach_layer_surface(struct samure_output *o,
+                                        struct samure_layer_surface *sfc) {
+  for (size_t i = 0; i < o->num_sfc; i++) {
+    if (o->sfc[i] == sfc) {
+      memmove(&o->sfc[i], &o->sfc[i + 1],
+              (o->num_sfc - i - 1) * sizeof(struct samure_layer_surface *));
+      o->num_sfc--;
+      sfc->output = NULL;
+      return;
+    }
+  }
 }
 
 extern SAMURE_RESULT(shared_buffer)
@@ -184,3 +218,116 @@ extern SAMURE_RESULT(shared_buffer)
 
   SAMURE_RETURN_RESULT(shared_buffer, buffer);
 }
+
+SAMURE_RESULT(screenshot)
+samure_output_screenshot_async(struct samure_context *ctx,
+                               struct samure_output *output,
+                               int capture_cursor) {
+  samure_error error_code = SAMURE_ERROR_NONE;
+  if (!ctx->shm)
+    error_code |= SAMURE_ERROR_NO_SHM;
+  if (!ctx->screencopy_manager)
+    error_code |= SAMURE_ERROR_NO_SCREENCOPY_MANAGER;
+  if (error_code != SAMURE_ERROR_NONE) {
+    SAMURE_RETURN_ERROR(screenshot, error_code);
+  }
+
+  struct samure_screenshot **screenshots =
+      realloc(ctx->screenshots,
+              (ctx->num_screenshots + 1) * sizeof(struct samure_screenshot *));
+  if (!screenshots) {
+    SAMURE_RETURN_ERROR(screenshot, SAMURE_ERROR_MEMORY);
+  }
+  ctx->screenshots = screenshots;
+
+  SAMURE_RESULT_ALLOC(screenshot, s);
+  s->data.ctx = ctx;
+  s->data.output = output;
+  s->data.buffer_rs.error = SAMURE_ERROR_NOT_IMPLEMENTED;
+  s->data.async = 1;
+
+  s->frame = zwlr_screencopy_manager_v1_capture_output(
+      ctx->screencopy_manager, capture_cursor, output->output);
+  if (!s->frame) {
+    free(s);
+    SAMURE_RETURN_ERROR(screenshot, SAMURE_ERROR_FRAME_INIT);
+  }
+  zwlr_screencopy_frame_v1_add_listener(s->frame, &screencopy_frame_listener,
+                                        &s->data);
+
+  ctx->screenshots[ctx->num_screenshots] = s;
+  ctx->num_screenshots++;
+
+  SAMURE_RETURN_RESULT(screenshot, s);
+}
+
+void samure_screenshot_copy(struct samure_screenshot *s) {
+  if (SAMURE_HAS_ERROR(s->data.buffer_rs)) {
+    s->data.state = SAMURE_SCREENSHOT_FAILED;
+    samure_screenshot_finish(s);
+    return;
+  }
+
+  s->data.state = SAMURE_SCREENSHOT_PENDING;
+  zwlr_screencopy_frame_v1_copy(s->frame, s->data.buffer_rs.result->buffer);
+}
+
+void samure_screenshot_finish(struct samure_screenshot *s) {
+  struct samure_context *ctx = s->data.ctx;
+
+  struct samure_shared_buffer *buffer = NULL;
+  if (!SAMURE_HAS_ERROR(s->data.buffer_rs)) {
+    buffer = s->data.buffer_rs.result;
+    s->data.buffer_rs.result = NULL;
+    s->data.buffer_rs.error = SAMURE_ERROR_NOT_IMPLEMENTED;
+  }
+
+  struct samure_event *e = samure_context_new_event(ctx);
+  if (!e || s->data.state != SAMURE_SCREENSHOT_READY) {
+    if (buffer) {
+      samure_destroy_shared_buffer(buffer);
+    }
+    buffer = NULL;
+  }
+
+  if (!e) {
+    // Nobody will be told about it, so it does not need to be kept around
+    samure_destroy_screenshot(ctx, s);
+    return;
+  }
+
+  e->type = s->data.state == SAMURE_SCREENSHOT_READY
+                ? SAMURE_EVENT_SCREENSHOT_READY
+                : SAMURE_EVENT_SCREENSHOT_FAILED;
+  e->output = s->data.output;
+  e->screenshot = s;
+  e->buffer = buffer;
+}
+
+void samure_destroy_screenshot(struct samure_context *ctx,
+                               struct samure_screenshot *s) {
+  for (size_t i = 0; i < ctx->num_screenshots; i++) {
+    if (ctx->screenshots[i] == s) {
+      ctx->screenshots[i] = ctx->screenshots[ctx->num_screenshots - 1];
+      ctx->num_screenshots--;
+      break;
+    }
+  }
+
+  if (!SAMURE_HAS_ERROR(s->data.buffer_rs)) {
+    samure_destroy_shared_buffer(s->data.buffer_rs.result);
+  }
+  zwlr_screencopy_frame_v1_destroy(s->frame);
+  free(s);
+}
+
+void samure_cancel_screenshot(struct samure_context *ctx,
+                              struct samure_screenshot *s) {
+  if (s->data.state == SAMURE_SCREENSHOT_READY ||
+      s->data.state == SAMURE_SCREENSHOT_FAILED) {
+    // The event is already on its way and destroys it
+    return;
+  }
+
+  samure_destroy_screenshot(ctx, s);
+}
@@ -27,6 +27,7 @@
 #pragma once
 
 #include "error_handling.h"
+#include "frame_timer.h"
 #include "layer_surface.h"
 #include "rect.h"
 #include "shared_memory.h"
@@ -56,6 +57,12 @@ struct samure_output {
 
   struct samure_rect geo;
   char *name;
+  int32_t refresh_rate; // Refresh rate of the current mode in mHz or 0 if it
+                        // is unknown
+  struct samure_frame_timer frame_timer; // Paces the rendering of this output
+                                         // with per_output_refresh
+  uint32_t registry_name; // Name of the wl_output global
+  int done; // Whether all properties of the output have been received
 };
 
 enum samure_screenshot_state {
@@ -70,12 +77,26 @@ struct samure_screenshot_data {
   struct samure_output *output;
   SAMURE_RESULT(shared_buffer) buffer_rs;
   enum samure_screenshot_state state;
+  int async; // Whether data is part of a samure_screenshot
+};
+
+// public
+// A screenshot that is taken in the background
+struct samure_screenshot {
+  struct samure_screenshot_data data;
+  struct zwlr_screencopy_frame_v1 *frame;
 };
 
 SAMURE_DEFINE_RESULT(output);
+SAMURE_DEFINE_RESULT(screenshot);
 
+// The properties of the output are known after the next roundtrip
 extern SAMURE_RESULT(output)
     samure_create_output(struct samure_context *ctx, struct wl_output *output);
+// Creates the xdg output if it does not exist yet and the xdg output manager
+// is available
+extern void samure_output_create_xdg_output(struct samure_context *ctx,
+                                            struct samure_output *output);
 extern void samure_destroy_output(struct samure_context *ctx,
                                   struct samure_output *output);
 
@@ -98,8 +119,34 @@ extern void samure_output_set_keyboard_interaction(struct samure_output *output,
 extern void
 samure_output_attach_layer_surface(struct samure_output *output,
                                    struct samure_layer_surface *layer_surface);
+// Removes the layer surface from the output without destroying it
+extern void
+samure_output_detach_layer_surface(struct samure_output *output,
+                                   struct samure_layer_surface *layer_surface);
 
 // public
 extern SAMURE_RESULT(shared_buffer)
     samure_output_screenshot(struct samure_context *ctx,
                              struct samure_output *output, int capture_cursor);
+
+// public
+// Starts to take a screenshot of output and returns immediately. The
+// screenshot finishes while the events are processed and is delivered with
+// SAMURE_EVENT_SCREENSHOT_READY or SAMURE_EVENT_SCREENSHOT_FAILED
+extern SAMURE_RESULT(screenshot)
+    samure_output_screenshot_async(struct samure_context *ctx,
+                                   struct samure_output *output,
+                                   int capture_cursor);
+
+// public
+// Stops a screenshot whose event has not been sent yet and destroys it
+extern void samure_cancel_screenshot(struct samure_context *ctx,
+                                     struct samure_screenshot *screenshot);
+
+// Copies the frame into the buffer once its parameters are known
+extern void samure_screenshot_copy(struct samure_screenshot *screenshot);
+// Sends the event of a finished screenshot
+extern void samure_screenshot_finish(struct samure_screenshot *screenshot);
+// Destroys a finished screenshot after its event has been processed
+extern void samure_destroy_screenshot(struct samure_context *ctx,
+                                      struct samure_screenshot *screenshot);
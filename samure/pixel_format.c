@@ -0,0 +1,503 @@
+/***********************************************************************************
+ *                         This file is part of samurai-render
+ *                    https://github.com/Samudevv/samurai-render
+ ***********************************************************************************
+ * Copyright (c) 2026 Kassandra Pucher
+ *
+ * This software is provided ‘as-is’, without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ * claim that you wrote the original software. If you use this software
+ * in a product, an acknowledgment in the product documentation would be
+ * appreciated but is not required.
+ *
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ * misrepresented as being the original software.
+ *
+ * 3. This notice may not be removed or altered from any source
+ * distribution.
+ ************************************************************************************/
+
+#include "pixel_format.h"
+#include <string.h>
+#include <wayland-client.h>
+
+#if defined(__x86_64__) || (defined(__i386__) && defined(__SSE2__))
+#define SAMURE_PIXEL_FORMAT_X86
+#include <immintrin.h>
+#elif defined(__ARM_NEON)
+#define SAMURE_PIXEL_FORMAT_NEON
+#include <arm_neon.h>
+#endif
+
+// Converts one row of width pixels. swap_rb swaps the red and blue channels
+// and opaque sets the alpha channel to 0xff
+typedef void (*samure_convert_row_func)(uint8_t *dst, const uint8_t *src,
+                                        int32_t width, int swap_rb,
+                                        int opaque);
+
+static inline uint32_t samure_load_u32(const uint8_t *p) {
+  uint32_t v;
+  memcpy(&v, p, sizeof(v));
+  return v;
+}
+
+static inline uint16_t samure_load_u16(const uint8_t *p) {
+  uint16_t v;
+  memcpy(&v, p, sizeof(v));
+  return v;
+}
+
+static inline void samure_store_u32(uint8_t *p, uint32_t v) {
+  memcpy(p, &v, sizeof(v));
+}
+
+static void samure_convert_row_8888_scalar(uint8_t *dst, const uint8_t *src,
+                                           int32_t width, int swap_rb,
+                                           int opaque) {
+  const uint32_t alpha = opaque ? 0xff000000 : 0;
+  for (int32_t x = 0; x < width; x++) {
+    uint32_t p = samure_load_u32(src + x * 4);
+    if (swap_rb) {
+      p = (p & 0xff00ff00) | ((p >> 16) & 0xff) | ((p & 0xff) << 16);
+    }
+    samure_store_u32(dst + x * 4, p | alpha);
+  }
+}
+
+static void samure_convert_row_2101010_scalar(uint8_t *dst,
+                                              const uint8_t *src,
+                                              int32_t width, int swap_rb,
+                                              int opaque) {
+  const uint32_t alpha = opaque ? 0xff000000 : 0;
+  for (int32_t x = 0; x < width; x++) {
+    const uint32_t p = samure_load_u32(src + x * 4);
+    // Replicate the 2 alpha bits into all 8 bits
+    uint32_t a = p & 0xc0000000;
+    a |= a >> 2;
+    a |= a >> 4;
+
+    const uint32_t hi = (p >> 22) & 0xff;
+    const uint32_t mid = (p >> 12) & 0xff;
+    const uint32_t lo = (p >> 2) & 0xff;
+    const uint32_t rgb = swap_rb ? ((lo << 16) | (mid << 8) | hi)
+                                 : ((hi << 16) | (mid << 8) | lo);
+    samure_store_u32(dst + x * 4, a | rgb | alpha);
+  }
+}
+
+static void samure_convert_row_565_scalar(uint8_t *dst, const uint8_t *src,
+                                          int32_t width, int swap_rb,
+                                          int opaque) {
+  for (int32_t x = 0; x < width; x++) {
+    const uint32_t p = samure_load_u16(src + x * 2);
+    uint32_t hi = (p >> 11) & 0x1f;
+    uint32_t mid = (p >> 5) & 0x3f;
+    uint32_t lo = p & 0x1f;
+    hi = (hi << 3) | (hi >> 2);
+    mid = (mid << 2) | (mid >> 4);
+    lo = (lo << 3) | (lo >> 2);
+
+    const uint32_t rgb = swap_rb ? ((lo << 16) | (mid << 8) | hi)
+                                 : ((hi << 16) | (mid << 8) | lo);
+    samure_store_u32(dst + x * 4, 0xff000000 | rgb);
+  }
+}
+
+#ifdef SAMURE_PIXEL_FORMAT_X86
+
+static void samure_convert_row_8888_sse2(uint8_t *dst, const uint8_t *src,
+                                         int32_t width, int swap_rb,
+                                         int opaque) {
+  const __m128i alpha = _mm_set1_epi32(opaque ? (int32_t)0xff000000 : 0);
+  const __m128i ga_mask = _mm_set1_epi32((int32_t)0xff00ff00);
+  const __m128i byte_mask = _mm_set1_epi32(0xff);
+
+  int32_t x = 0;
+  for (; x + 4 <= width; x += 4) {
+    __m128i p = _mm_loadu_si128((const __m128i *)(src + x * 4));
+    if (swap_rb) {
+      const __m128i r = _mm_and_si128(_mm_srli_epi32(p, 16), byte_mask);
+      const __m128i b = _mm_slli_epi32(_mm_and_si128(p, byte_mask), 16);
+      p = _mm_or_si128(_mm_and_si128(p, ga_mask), _mm_or_si128(r, b));
+    }
+    _mm_storeu_si128((__m128i *)(dst + x * 4), _mm_or_si128(p, alpha));
+  }
+
+  samure_convert_row_8888_scalar(dst + x * 4, src + x * 4, width - x, swap_rb,
+                                 opaque);
+}
+
+static void samure_convert_row_2101010_sse2(uint8_t *dst, const uint8_t *src,
+                                            int32_t width, int swap_rb,
+                                            int opaque) {
+  const __m128i alpha = _mm_set1_epi32(opaque ? (int32_t)0xff000000 : 0);
+  const __m128i alpha_mask = _mm_set1_epi32((int32_t)0xc0000000);
+  const __m128i byte_mask = _mm_set1_epi32(0xff);
+
+  int32_t x = 0;
+  for (; x + 4 <= width; x += 4) {
+    const __m128i p = _mm_loadu_si128((const __m128i *)(src + x * 4));
+    __m128i a = _mm_and_si128(p, alpha_mask);
+    a = _mm_or_si128(a, _mm_srli_epi32(a, 2));
+    a = _mm_or_si128(a, _mm_srli_epi32(a, 4));
+
+    __m128i hi = _mm_and_si128(_mm_srli_epi32(p, 22), byte_mask);
+    const __m128i mid = _mm_and_si128(_mm_srli_epi32(p, 12), byte_mask);
+    __m128i lo = _mm_and_si128(_mm_srli_epi32(p, 2), byte_mask);
+    if (swap_rb) {
+      const __m128i t = hi;
+      hi = lo;
+      lo = t;
+    }
+
+    const __m128i rgb = _mm_or_si128(
+        _mm_slli_epi32(hi, 16), _mm_or_si128(_mm_slli_epi32(mid, 8), lo));
+    _mm_storeu_si128((__m128i *)(dst + x * 4),
+                     _mm_or_si128(_mm_or_si128(a, rgb), alpha));
+  }
+
+  samure_convert_row_2101010_scalar(dst + x * 4, src + x * 4, width - x,
+                                    swap_rb, opaque);
+}
+
+// Converts 4 RGB565 pixels that have been zero extended to 32 bits
+static inline __m128i samure_convert_565_sse2(__m128i p, int swap_rb) {
+  __m128i hi = _mm_and_si128(_mm_srli_epi32(p, 11), _mm_set1_epi32(0x1f));
+  __m128i mid = _mm_and_si128(_mm_srli_epi32(p, 5), _mm_set1_epi32(0x3f));
+  __m128i lo = _mm_and_si128(p, _mm_set1_epi32(0x1f));
+  hi = _mm_or_si128(_mm_slli_epi32(hi, 3), _mm_srli_epi32(hi, 2));
+  mid = _mm_or_si128(_mm_slli_epi32(mid, 2), _mm_srli_epi32(mid, 4));
+  lo = _mm_or_si128(_mm_slli_epi32(lo, 3), _mm_srli_epi32(lo, 2));
+  if (swap_rb) {
+    const __m128i t = hi;
+    hi = lo;
+    lo = t;
+  }
+
+  const __m128i rgb = _mm_or_si128(_mm_slli_epi32(hi, 16),
+                                   _mm_or_si128(_mm_slli_epi32(mid, 8), lo));
+  return _mm_or_si128(rgb, _mm_set1_epi32((int32_t)0xff000000));
+}
+
+static void samure_convert_row_565_sse2(uint8_t *dst, const uint8_t *src,
+                                        int32_t width, int swap_rb,
+                                        int opaque) {
+  const __m128i zero = _mm_setzero_si128();
+
+  int32_t x = 0;
+  for (; x + 8 <= width; x += 8) {
+    const __m128i p = _mm_loadu_si128((const __m128i *)(src + x * 2));
+    _mm_storeu_si128(
+        (__m128i *)(dst + x * 4),
+        samure_convert_565_sse2(_mm_unpacklo_epi16(p, zero), swap_rb));
+    _mm_storeu_si128(
+        (__m128i *)(dst + x * 4 + 16),
+        samure_convert_565_sse2(_mm_unpackhi_epi16(p, zero), swap_rb));
+  }
+
+  samure_convert_row_565_scalar(dst + x * 4, src + x * 2, width - x, swap_rb,
+                                opaque);
+}
+
+__attribute__((target("avx2"))) static void
+samure_convert_row_8888_avx2(uint8_t *dst, const uint8_t *src, int32_t width,
+                             int swap_rb, int opaque) {
+  const __m256i alpha = _mm256_set1_epi32(opaque ? (int32_t)0xff000000 : 0);
+  const __m256i shuffle =
+      swap_rb ? _mm256_setr_epi8(2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13,
+                                 12, 15, 2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11,
+                                 14, 13, 12, 15)
+              : _mm256_setr_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13,
+                                 14, 15, 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11,
+                                 12, 13, 14, 15);
+
+  int32_t x = 0;
+  for (; x + 16 <= width; x += 16) {
+    __m256i p0 = _mm256_loadu_si256((const __m256i *)(src + x * 4));
+    __m256i p1 = _mm256_loadu_si256((const __m256i *)(src + x * 4 + 32));
+    p0 = _mm256_or_si256(_mm256_shuffle_epi8(p0, shuffle), alpha);
+    p1 = _mm256_or_si256(_mm256_shuffle_epi8(p1, shuffle), alpha);
+    _mm256_storeu_si256((__m256i *)(dst + x * 4), p0);
+    _mm256_storeu_si256((__m256i *)(dst + x * 4 + 32), p1);
+  }
+
+  samure_convert_row_8888_sse2(dst + x * 4, src + x * 4, width - x, swap_rb,
+                               opaque);
+}
+
+__attribute__((target("avx2"))) static void
+samure_convert_row_2101010_avx2(uint8_t *dst, const uint8_t *src,
+                                int32_t width, int swap_rb, int opaque) {
+  const __m256i alpha = _mm256_set1_epi32(opaque ? (int32_t)0xff000000 : 0);
+  const __m256i alpha_mask = _mm256_set1_epi32((int32_t)0xc0000000);
+  const __m256i byte_mask = _mm256_set1_epi32(0xff);
+
+  int32_t x = 0;
+  for (; x + 8 <= width; x += 8) {
+    const __m256i p = _mm256_loadu_si256((const __m256i *)(src + x * 4));
+    __m256i a = _mm256_and_si256(p, alpha_mask);
+    a = _mm256_or_si256(a, _mm256_srli_epi32(a, 2));
+    a = _mm256_or_si256(a, _mm256_srli_epi32(a, 4));
+
+    __m256i hi = _mm256_and_si256(_mm256_srli_epi32(p, 22), byte_mask);
+    const __m256i mid = _mm256_and_si256(_mm256_srli_epi32(p, 12), byte_mask);
+    __m256i lo = _mm256_and_si256(_mm256_srli_epi32(p, 2), byte_mask);
+    if (swap_rb) {
+      const __m256i t = hi;
+      hi = lo;
+      lo = t;
+    }
+
+    const __m256i rgb =
+        _mm256_or_si256(_mm256_slli_epi32(hi, 16),
+                        _mm256_or_si256(_mm256_slli_epi32(mid, 8), lo));
+    _mm256_storeu_si256((__m256i *)(dst + x * 4),
+                        _mm256_or_si256(_mm256_or_si256(a, rgb), alpha));
+  }
+
+  samure_convert_row_2101010_sse2(dst + x * 4, src + x * 4, width - x,
+                                  swap_rb, opaque);
+}
+
+// Converts 8 RGB565 pixels that have been zero extended to 32 bits
+__attribute__((target("avx2"))) static inline __m256i
+samure_convert_565_avx2(__m256i p, int swap_rb) {
+  __m256i hi =
+      _mm256_and_si256(_mm256_srli_epi32(p, 11), _mm256_set1_epi32(0x1f));
+  __m256i mid =
+      _mm256_and_si256(_mm256_srli_epi32(p, 5), _mm256_set1_epi32(0x3f));
+  __m256i lo = _mm256_and_si256(p, _mm256_set1_epi32(0x1f));
+  hi = _mm256_or_si256(_mm256_slli_epi32(hi, 3), _mm256_srli_epi32(hi, 2));
+  mid = _mm256_or_si256(_mm256_slli_epi32(mid, 2), _mm256_srli_epi32(mid, 4));
+  lo = _mm256_or_si256(_mm256_slli_epi32(lo, 3), _mm256_srli_epi32(lo, 2));
+  if (swap_rb) {
+    const __m256i t = hi;
+    hi = lo;
+    lo = t;
+  }
+
+  const __m256i rgb =
+      _mm256_or_si256(_mm256_slli_epi32(hi, 16),
+                      _mm256_or_si256(_mm256_slli_epi32(mid, 8), lo));
+  return _mm256_or_si256(rgb, _mm256_set1_epi32((int32_t)0xff000000));
+}
+
+__attribute__((target("avx2"))) static void
+samure_convert_row_565_avx2(uint8_t *dst, const uint8_t *src, int32_t width,
+                            int swap_rb, int opaque) {
+  int32_t x = 0;
+  for (; x + 16 <= width; x += 16) {
+    const __m128i p0 = _mm_loadu_si128((const __m128i *)(src + x * 2));
+    const __m128i p1 = _mm_loadu_si128((const __m128i *)(src + x * 2 + 16));
+    _mm256_storeu_si256(
+        (__m256i *)(dst + x * 4),
+        samure_convert_565_avx2(_mm256_cvtepu16_epi32(p0), swap_rb));
+    _mm256_storeu_si256(
+        (__m256i *)(dst + x * 4 + 32),
+        samure_convert_565_avx2(_mm256_cvtepu16_epi32(p1), swap_rb));
+  }
+
+  samure_convert_row_565_sse2(dst + x * 4, src + x * 2, width - x, swap_rb,
+                              opaque);
+}
+
+#define SAMURE_SELECT_CONVERT_ROW_FUNC(name)                                   \
+  (__builtin_cpu_supports("avx2") ? samure_convert_row_##name##_avx2          \
+                                  : samure_convert_row_##name##_sse2)
+
+#elif defined(SAMURE_PIXEL_FORMAT_NEON)
+
+static void samure_convert_row_8888_neon(uint8_t *dst, const uint8_t *src,
+                                         int32_t width, int swap_rb,
+                                         int opaque) {
+  int32_t x = 0;
+  for (; x + 16 <= width; x += 16) {
+    uint8x16x4_t p = vld4q_u8(src + x * 4);
+    if (swap_rb) {
+      const uint8x16_t t = p.val[0];
+      p.val[0] = p.val[2];
+      p.val[2] = t;
+    }
+    if (opaque) {
+      p.val[3] = vdupq_n_u8(0xff);
+    }
+    vst4q_u8(dst + x * 4, p);
+  }
+
+  samure_convert_row_8888_scalar(dst + x * 4, src + x * 4, width - x, swap_rb,
+                                 opaque);
+}
+
+static void samure_convert_row_2101010_neon(uint8_t *dst, const uint8_t *src,
+                                            int32_t width, int swap_rb,
+                                            int opaque) {
+  const uint32x4_t alpha = vdupq_n_u32(opaque ? 0xff000000 : 0);
+  const uint32x4_t alpha_mask = vdupq_n_u32(0xc0000000);
+  const uint32x4_t byte_mask = vdupq_n_u32(0xff);
+
+  int32_t x = 0;
+  for (; x + 4 <= width; x += 4) {
+    const uint32x4_t p = vreinterpretq_u32_u8(vld1q_u8(src + x * 4));
+    uint32x4_t a = vandq_u32(p, alpha_mask);
+    a = vorrq_u32(a, vshrq_n_u32(a, 2));
+    a = vorrq_u32(a, vshrq_n_u32(a, 4));
+
+    uint32x4_t hi = vandq_u32(vshrq_n_u32(p, 22), byte_mask);
+    const uint32x4_t mid = vandq_u32(vshrq_n_u32(p, 12), byte_mask);
+    uint32x4_t lo = vandq_u32(vshrq_n_u32(p, 2), byte_mask);
+    if (swap_rb) {
+      const uint32x4_t t = hi;
+      hi = lo;
+      lo = t;
+    }
+
+    const uint32x4_t rgb =
+        vorrq_u32(vshlq_n_u32(hi, 16), vorrq_u32(vshlq_n_u32(mid, 8), lo));
+    vst1q_u8(dst + x * 4,
+             vreinterpretq_u8_u32(vorrq_u32(vorrq_u32(a, rgb), alpha)));
+  }
+
+  samure_convert_row_2101010_scalar(dst + x * 4, src + x * 4, width - x,
+                                    swap_rb, opaque);
+}
+
+static void samure_convert_row_565_neon(uint8_t *dst, const uint8_t *src,
+                                        int32_t width, int swap_rb,
+                                        int opaque) {
+  int32_t x = 0;
+  for (; x + 8 <= width; x += 8) {
+    const uint16x8_t p = vreinterpretq_u16_u8(vld1q_u8(src + x * 2));
+    uint8x8_t hi = vmovn_u16(vshrq_n_u16(p, 11));
+    uint8x8_t mid = vmovn_u16(vandq_u16(vshrq_n_u16(p, 5), vdupq_n_u16(0x3f)));
+    uint8x8_t lo = vmovn_u16(vandq_u16(p, vdupq_n_u16(0x1f)));
+    hi = vorr_u8(vshl_n_u8(hi, 3), vshr_n_u8(hi, 2));
+    mid = vorr_u8(vshl_n_u8(mid, 2), vshr_n_u8(mid, 4));
+    lo = vorr_u8(vshl_n_u8(lo, 3), vshr_n_u8(lo, 2));
+
+    uint8x8x4_t bgra;
+    bgra.val[0] = swap_rb ? hi : lo;
+    bgra.val[1] = mid;
+    bgra.val[2] = swap_rb ? lo : hi;
+    bgra.val[3] = vdup_n_u8(0xff);
+    vst4_u8(dst + x * 4, bgra);
+  }
+
+  samure_convert_row_565_scalar(dst + x * 4, src + x * 2, width - x, swap_rb,
+                                opaque);
+}
+
+#define SAMURE_SELECT_CONVERT_ROW_FUNC(name) samure_convert_row_##name##_neon
+
+#else
+
+#define SAMURE_SELECT_CONVERT_ROW_FUNC(name) samure_convert_row_##name##_scalar
+
+#endif
+
+// Returns the function that converts rows of src_format to ARGB8888 or NULL
+// if the format is not supported
+static samure_convert_row_func
+samure_select_convert_row_func(uint32_t src_format, int *swap_rb,
+                               int *opaque) {
+  switch (src_format) {
+  case WL_SHM_FORMAT_ARGB8888:
+  case WL_SHM_FORMAT_XRGB8888:
+  case WL_SHM_FORMAT_ABGR8888:
+  case WL_SHM_FORMAT_XBGR8888:
+    *swap_rb = src_format == WL_SHM_FORMAT_ABGR8888 ||
+               src_format == WL_SHM_FORMAT_XBGR8888;
+    *opaque = src_format == WL_SHM_FORMAT_XRGB8888 ||
+              src_format == WL_SHM_FORMAT_XBGR8888;
+    return SAMURE_SELECT_CONVERT_ROW_FUNC(8888);
+  case WL_SHM_FORMAT_ARGB2101010:
+  case WL_SHM_FORMAT_XRGB2101010:
+  case WL_SHM_FORMAT_ABGR2101010:
+  case WL_SHM_FORMAT_XBGR2101010:
+    *swap_rb = src_format == WL_SHM_FORMAT_ABGR2101010 ||
+               src_format == WL_SHM_FORMAT_XBGR2101010;
+    *opaque = src_format == WL_SHM_FORMAT_XRGB2101010 ||
+              src_format == WL_SHM_FORMAT_XBGR2101010;
+    return SAMURE_SELECT_CONVERT_ROW_FUNC(2101010);
+  case WL_SHM_FORMAT_RGB565:
+  case WL_SHM_FORMAT_BGR565:
+    *swap_rb = src_format == WL_SHM_FORMAT_BGR565;
+    *opaque = 1;
+    return SAMURE_SELECT_CONVERT_ROW_FUNC(565);
+  default:
+    return NULL;
+  }
+}
+
+uint32_t samure_format_bytes_per_pixel(uint32_t format) {
+  switch (format) {
+  case WL_SHM_FORMAT_RGB565:
+  case WL_SHM_FORMAT_BGR565:
+    return 2;
+  case WL_SHM_FORMAT_RGB888:
+  case WL_SHM_FORMAT_BGR888:
+    return 3;
+  default:
+    return 4;
+  }
+}
+
+int samure_can_convert_pixels(uint32_t dst_format, uint32_t src_format) {
+  if (dst_format == src_format) {
+    return 1;
+  }
+  if (dst_format != WL_SHM_FORMAT_ARGB8888 &&
+      dst_format != WL_SHM_FORMAT_XRGB8888) {
+    return 0;
+  }
+
+  int swap_rb, opaque;
+  return samure_select_convert_row_func(src_format, &swap_rb, &opaque) != NULL;
+}
+
+samure_error samure_convert_pixels(void *dst, int32_t dst_stride,
+                                   uint32_t dst_format, const void *src,
+                                   int32_t src_stride, uint32_t src_format,
+                                   int32_t width, int32_t height) {
+  uint8_t *d = (uint8_t *)dst;
+  const uint8_t *s = (const uint8_t *)src;
+
+  if (dst_format == src_format) {
+    const size_t row_size =
+        (size_t)width * samure_format_bytes_per_pixel(src_format);
+    if (dst_stride == src_stride && (size_t)src_stride == row_size) {
+      memcpy(d, s, row_size * (size_t)height);
+      return SAMURE_ERROR_NONE;
+    }
+
+    for (int32_t y = 0; y < height; y++) {
+      memcpy(d + (size_t)y * dst_stride, s + (size_t)y * src_stride, row_size);
+    }
+    return SAMURE_ERROR_NONE;
+  }
+
+  if (dst_format != WL_SHM_FORMAT_ARGB8888 &&
+      dst_format != WL_SHM_FORMAT_XRGB8888) {
+    return SAMURE_ERROR_FAILED;
+  }
+
+  int swap_rb, opaque;
+  const samure_convert_row_func convert_row =
+      samure_select_convert_row_func(src_format, &swap_rb, &opaque);
+  if (!convert_row) {
+    return SAMURE_ERROR_FAILED;
+  }
+
+  for (int32_t y = 0; y < height; y++) {
+    convert_row(d + (size_t)y * dst_stride, s + (size_t)y * src_stride, width,
+                swap_rb, opaque);
+  }
+
+  return SAMURE_ERROR_NONE;
+}
@@ -0,0 +1,53 @@
+/***********************************************************************************
+ *                         This file is part of samurai-render
+ *                    https://github.com/Samudevv/samurai-render
+ ***********************************************************************************
+ * Copyright (c) 2026 Kassandra Pucher
+ *
+ * This software is provided ‘as-is’, without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ * claim that you wrote the original software. If you use this software
+ * in a product, an acknowledgment in the product documentation would be
+ * appreciated but is not required.
+ *
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ * misrepresented as being the original software.
+ *
+ * 3. This notice may not be removed or altered from any source
+ * distribution.
+ ************************************************************************************/
+
+#pragma once
+
+#include <stdint.h>
+
+#include "error_handling.h"
+
+// public
+// Returns the number of bytes of one pixel of a wl_shm format. Formats that are
+// unknown to samure are assumed to have 4 bytes per pixel
+extern uint32_t samure_format_bytes_per_pixel(uint32_t format);
+
+// public
+// Returns whether samure_convert_pixels can convert from src_format to
+// dst_format
+extern int samure_can_convert_pixels(uint32_t dst_format, uint32_t src_format);
+
+// public
+// Converts width*height pixels from src_format to dst_format.
+// The destination can be ARGB8888 or XRGB8888 and the source any of
+// [AX]RGB8888, [AX]BGR8888, [AX]RGB2101010, [AX]BGR2101010, RGB565 and BGR565.
+// Identical formats are copied. The alpha channel of sources without alpha is
+// set to 0xff. Uses AVX2, SSE2 or NEON kernels depending on the cpu
+extern samure_error samure_convert_pixels(void *dst, int32_t dst_stride,
+                                          uint32_t dst_format, const void *src,
+                                          int32_t src_stride,
+                                          uint32_t src_format, int32_t width,
+                                          int32_t height);
@@ -67,3 +67,36 @@ int samure_triangle_in_output(struct samure_rect o, int32_t x1, int32_t y1,
   return samure_point_in_output(o, x1, y1) ||
          samure_point_in_output(o, x2, y2) || samure_point_in_output(o, x3, y3);
 }
+
+struct samure_rect samure_rect_union(struct samure_rect a,
+                                     struct samure_rect b) {
+  if (a.w <= 0 || a.h <= 0) {
+    return b;
+  }
+  if (b.w <= 0 || b.h <= 0) {
+    return a;
+  }
+
+  const int32_t x1 = a.x < b.x ? a.x : b.x;
+  const int32_t y1 = a.y < b.y ? a.y : b.y;
+  const int32_t x2 = (a.x + a.w) > (b.x + b.w) ? (a.x + a.w) : (b.x + b.w);
+  const int32_t y2 = (a.y + a.h) > (b.y + b.h) ? (a.y + a.h) : (b.y + b.h);
+
+  struct samure_rect r = {.x = x1, .y = y1, .w = x2 - x1, .h = y2 - y1};
+  return r;
+}
+
+struct samure_rect samure_rect_intersection(struct samure_rect a,
+                                            struct samure_rect b) {
+  const int32_t x1 = a.x > b.x ? a.x : b.x;
+  const int32_t y1 = a.y > b.y ? a.y : b.y;
+  const int32_t x2 = (a.x + a.w) < (b.x + b.w) ? (a.x + a.w) : (b.x + b.w);
+  const int32_t y2 = (a.y + a.h) < (b.y + b.h) ? (a.y + a.h) : (b.y + b.h);
+
+  struct samure_rect r = {.x = x1, .y = y1, .w = 0, .h = 0};
+  if (x2 > x1 && y2 > y1) {
+    r.w = x2 - x1;
+    r.h = y2 - y1;
+  }
+  return r;
+}
@@ -56,3 +56,12 @@ extern int samure_triangle_in_output(struct samure_rect output_geo,
                                      int32_t tri_x1, int32_t tri_y1,
                                      int32_t tri_x2, int32_t tri_y2,
                                      int32_t tri_x3, int32_t tri_y3);
+// public
+// Returns the smallest rectangle that contains both rectangles
+extern struct samure_rect samure_rect_union(struct samure_rect a,
+                                            struct samure_rect b);
+// public
+// Returns the overlapping area of both rectangles. The width and height are
+// zero if they do not overlap
+extern struct samure_rect samure_rect_intersection(struct samure_rect a,
+                                                   struct samure_rect b);
@@ -0,0 +1,289 @@
+/***********************************************************************************
+ *                         This file is part of samurai-render
+ *                    https://github.com/Samudevv/samurai-render
+ ***********************************************************************************
+ * Copyright (c) 2026 Kassandra Pucher
+ *
+ * This software is provided ‘as-is’, without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ * claim that you wrote the original software. If you use this software
+ * in a product, an acknowledgment in the product documentation would be
+ * appreciated but is not required.
+ *
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ * misrepresented as being the original software.
+ *
+ * 3. This notice may not be removed or altered from any source
+ * distribution.
+ ************************************************************************************/
+
+#include "screencopy_stream.h"
+#include "callbacks.h"
+#include "context.h"
+#include <stdlib.h>
+#include <string.h>
+
+SAMURE_DEFINE_RESULT_UNWRAP(screencopy_stream);
+
+static void
+samure_screencopy_stream_request_frame(struct samure_screencopy_stream *s) {
+  s->frame = zwlr_screencopy_manager_v1_capture_output(
+      s->ctx->screencopy_manager, s->capture_cursor, s->output->output);
+  if (!s->frame) {
+    s->error |= SAMURE_ERROR_FRAME_INIT;
+    return;
+  }
+  zwlr_screencopy_frame_v1_add_listener(s->frame, &screencopy_stream_listener,
+                                        s);
+}
+
+// Destroys the buffers of the ring. The ones of frames whose events have not
+// been processed yet are only marked as stale unless force is set
+static void
+samure_screencopy_stream_destroy_buffers(struct samure_screencopy_stream *s,
+                                         int force) {
+  for (size_t i = 0; i < SAMURE_NUM_SCREENCOPY_BUFFERS; i++) {
+    struct samure_screencopy_frame *f = &s->frames[i];
+    if (!f->buffer) {
+      continue;
+    }
+    if (f->pending && !force) {
+      f->stale = 1;
+      continue;
+    }
+    samure_destroy_shared_buffer(f->buffer);
+    f->buffer = NULL;
+    f->stale = 0;
+  }
+}
+
+SAMURE_RESULT(screencopy_stream)
+samure_create_screencopy_stream(struct samure_context *ctx,
+                                struct samure_output *output,
+                                int capture_cursor) {
+  samure_error error_code = SAMURE_ERROR_NONE;
+  if (!ctx->shm)
+    error_code |= SAMURE_ERROR_NO_SHM;
+  if (!ctx->screencopy_manager)
+    error_code |= SAMURE_ERROR_NO_SCREENCOPY_MANAGER;
+  if (error_code != SAMURE_ERROR_NONE) {
+    SAMURE_RETURN_ERROR(screencopy_stream, error_code);
+  }
+
+  struct samure_screencopy_stream **streams = realloc(
+      ctx->screencopy_streams, (ctx->num_screencopy_streams + 1) *
+                                   sizeof(struct samure_screencopy_stream *));
+  if (!streams) {
+    SAMURE_RETURN_ERROR(screencopy_stream, SAMURE_ERROR_MEMORY);
+  }
+  ctx->screencopy_streams = streams;
+
+  SAMURE_RESULT_ALLOC(screencopy_stream, s);
+  s->ctx = ctx;
+  s->output = output;
+  s->capture_cursor = capture_cursor;
+  s->full_damage = 1;
+
+  samure_screencopy_stream_request_frame(s);
+  if (s->error != SAMURE_ERROR_NONE) {
+    free(s);
+    SAMURE_RETURN_ERROR(screencopy_stream, SAMURE_ERROR_FRAME_INIT);
+  }
+
+  ctx->screencopy_streams[ctx->num_screencopy_streams] = s;
+  ctx->num_screencopy_streams++;
+
+  SAMURE_RETURN_RESULT(screencopy_stream, s);
+}
+
+void samure_destroy_screencopy_stream(struct samure_context *ctx,
+                                      struct samure_screencopy_stream *s) {
+  for (size_t i = 0; i < ctx->num_screencopy_streams; i++) {
+    if (ctx->screencopy_streams[i] == s) {
+      ctx->screencopy_streams[i] =
+          ctx->screencopy_streams[ctx->num_screencopy_streams - 1];
+      ctx->num_screencopy_streams--;
+      break;
+    }
+  }
+
+  if (s->frame)
+    zwlr_screencopy_frame_v1_destroy(s->frame);
+  samure_screencopy_stream_destroy_buffers(s, 1);
+  free(s);
+}
+
+void samure_screencopy_stream_buffer(struct samure_screencopy_stream *s,
+                                     uint32_t format, int32_t width,
+                                     int32_t height, int32_t stride) {
+  if (format != s->format || width != s->width || height != s->height ||
+      stride != s->stride) {
+    // The buffers of the ring do not fit anymore
+    samure_screencopy_stream_destroy_buffers(s, 0);
+    s->format = format;
+    s->width = width;
+    s->height = height;
+    s->stride = stride;
+    s->full_damage = 1;
+  }
+
+  struct samure_screencopy_frame *f = &s->frames[s->frame_index];
+  if (f->buffer || f->pending) {
+    // A pending frame is skipped in samure_screencopy_stream_copy
+    return;
+  }
+
+  // The compositor decides about the stride, which might include padding
+  SAMURE_RESULT(shared_buffer) b_rs;
+  if (s->ctx->shm_arena) {
+    b_rs = samure_shm_arena_create_buffer_with_stride(
+        s->ctx->shm_arena, format, width, height, stride);
+  } else {
+    b_rs = samure_create_shared_buffer_with_stride(s->ctx->shm, format, width,
+                                                   height, stride);
+  }
+  if (SAMURE_HAS_ERROR(b_rs)) {
+    s->error |= b_rs.error;
+    return;
+  }
+  f->buffer = b_rs.result;
+}
+
+void samure_screencopy_stream_copy(struct samure_screencopy_stream *s) {
+  if (s->error != SAMURE_ERROR_NONE) {
+    samure_screencopy_stream_failed(s, s->error);
+    return;
+  }
+
+  struct samure_screencopy_frame *f = &s->frames[s->frame_index];
+  if (f->pending) {
+    // The application has not seen this frame yet, so nothing can be copied
+    // into it. Nothing has been copied either, so the compositor reports the
+    // damage of the skipped frame with the next one
+    zwlr_screencopy_frame_v1_destroy(s->frame);
+    s->frame = NULL;
+    s->waiting = 1;
+    return;
+  }
+  if (!f->buffer) {
+    // The compositor did not offer a shared memory buffer
+    samure_screencopy_stream_failed(s, SAMURE_ERROR_NOT_IMPLEMENTED);
+    return;
+  }
+
+  // The frame that used this slot before has been processed, so its damage
+  // and flags can be replaced
+  f->num_damage = 0;
+  f->flags = 0;
+
+  // Waits until something changed on the output
+  zwlr_screencopy_frame_v1_copy_with_damage(s->frame, f->buffer->buffer);
+}
+
+void samure_screencopy_stream_damage(struct samure_screencopy_stream *s,
+                                     struct samure_rect damage) {
+  struct samure_screencopy_frame *f = &s->frames[s->frame_index];
+
+  if (f->num_damage == SAMURE_MAX_SCREENCOPY_DAMAGE_RECTS) {
+    for (size_t i = 1; i < f->num_damage; i++) {
+      damage = samure_rect_union(damage, f->damage[i]);
+    }
+    f->damage[0] = samure_rect_union(damage, f->damage[0]);
+    f->num_damage = 1;
+    return;
+  }
+
+  f->damage[f->num_damage] = damage;
+  f->num_damage++;
+}
+
+void samure_screencopy_stream_ready(struct samure_screencopy_stream *s,
+                                    double time) {
+  struct samure_screencopy_frame *f = &s->frames[s->frame_index];
+  f->time = time;
+  if (s->full_damage || f->num_damage == 0) {
+    f->damage[0] = (struct samure_rect){
+        .x = 0,
+        .y = 0,
+        .w = s->width,
+        .h = s->height,
+    };
+    f->num_damage = 1;
+    s->full_damage = 0;
+  }
+
+  zwlr_screencopy_frame_v1_destroy(s->frame);
+  s->frame = NULL;
+  s->num_frames++;
+
+  struct samure_event *e = samure_context_new_event(s->ctx);
+  if (e) {
+    e->type = SAMURE_EVENT_SCREENCOPY_FRAME;
+    e->output = s->output;
+    e->screencopy_stream = s;
+    e->screencopy_frame = f;
+    f->pending = 1;
+  }
+
+  s->frame_index = (s->frame_index + 1) % SAMURE_NUM_SCREENCOPY_BUFFERS;
+  samure_screencopy_stream_request_frame(s);
+  if (s->error != SAMURE_ERROR_NONE) {
+    samure_screencopy_stream_failed(s, s->error);
+  }
+}
+
+void samure_screencopy_stream_failed(struct samure_screencopy_stream *s,
+                                     samure_error error) {
+  if (s->frame) {
+    zwlr_screencopy_frame_v1_destroy(s->frame);
+    s->frame = NULL;
+  }
+  s->error |= error | SAMURE_ERROR_FAILED;
+
+  struct samure_event *e = samure_context_new_event(s->ctx);
+  if (e) {
+    e->type = SAMURE_EVENT_SCREENCOPY_FAILED;
+    e->output = s->output;
+    e->screencopy_stream = s;
+    e->screencopy_frame = NULL;
+  }
+}
+
+void samure_screencopy_stream_frame_processed(
+    struct samure_screencopy_stream *s, struct samure_screencopy_frame *f) {
+  f->pending = 0;
+  if (f->stale) {
+    samure_destroy_shared_buffer(f->buffer);
+    f->buffer = NULL;
+    f->stale = 0;
+  }
+}
+
+void samure_screencopy_stream_resume(struct samure_screencopy_stream *s) {
+  if (!s->waiting || s->frames[s->frame_index].pending) {
+    return;
+  }
+
+  s->waiting = 0;
+  samure_screencopy_stream_request_frame(s);
+  if (s->error != SAMURE_ERROR_NONE) {
+    samure_screencopy_stream_failed(s, s->error);
+  }
+}
+
+void samure_screencopy_stream_stop(struct samure_screencopy_stream *s) {
+  if (s->frame) {
+    zwlr_screencopy_frame_v1_destroy(s->frame);
+    s->frame = NULL;
+  }
+  s->output = NULL;
+  s->waiting = 0;
+  s->error |= SAMURE_ERROR_FAILED;
+}
@@ -0,0 +1,127 @@
+/***********************************************************************************
+ *                         This file is part of samurai-render
+ *                    https://github.com/Samudevv/samurai-render
+ ***********************************************************************************
+ * Copyright (c) 2026 Kassandra Pucher
+ *
+ * This software is provided ‘as-is’, without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ * claim that you wrote the original software. If you use this software
+ * in a product, an acknowledgment in the product documentation would be
+ * appreciated but is not required.
+ *
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ * misrepresented as being the original software.
+ *
+ * 3. This notice may not be removed or altered from any source
+ * distribution.
+ ************************************************************************************/
+
+#pragma once
+
+#include "error_handling.h"
+#include "rect.h"
+#include "shared_memory.h"
+#include "wayland/screencopy.h"
+
+// public
+// How many buffers a screencopy stream cycles through
+#define SAMURE_NUM_SCREENCOPY_BUFFERS 3
+// public
+// If the compositor reports more damage rectangles for one frame they are
+// merged into their bounding box
+#define SAMURE_MAX_SCREENCOPY_DAMAGE_RECTS 32
+
+struct samure_context;
+struct samure_output;
+
+// public
+// One captured frame of a screencopy stream
+struct samure_screencopy_frame {
+  struct samure_shared_buffer *buffer;
+  // Regions that changed since the previous frame of the stream in buffer
+  // coordinates. The first frame is damaged completely
+  struct samure_rect damage[SAMURE_MAX_SCREENCOPY_DAMAGE_RECTS];
+  size_t num_damage;
+  uint32_t flags; // zwlr_screencopy_frame_v1_flags (e.g. y_invert)
+  double time;    // Time at which the content has been presented in seconds
+
+  int pending; // Whether its event is waiting to be processed. Until then the
+               // buffer is neither reused nor destroyed
+  int stale;   // Whether the buffer does not fit the output anymore and gets
+               // destroyed once the event has been processed
+};
+
+// public
+// Captures an output continuously. Every frame that differs from the previous
+// one is delivered with SAMURE_EVENT_SCREENCOPY_FRAME
+struct samure_screencopy_stream {
+  struct samure_context *ctx;
+  struct samure_output *output; // NULL if the output has been removed
+  int capture_cursor;
+
+  struct zwlr_screencopy_frame_v1 *frame; // The frame in flight or NULL
+  struct samure_screencopy_frame frames[SAMURE_NUM_SCREENCOPY_BUFFERS];
+  size_t frame_index; // Index of the frame that is copied next
+  uint64_t num_frames; // How many frames have been captured
+  int full_damage;     // Whether the next frame is damaged completely
+  int waiting;         // Whether the next frame is requested once the event
+                       // of the frame whose buffer is used next has been
+                       // processed
+
+  uint32_t format;
+  int32_t width;
+  int32_t height;
+  int32_t stride;
+  samure_error error; // Why the stream stopped
+};
+
+SAMURE_DEFINE_RESULT(screencopy_stream);
+
+// public
+// Starts to capture output until the stream gets destroyed. The frame of a
+// SCREENCOPY_FRAME event stays untouched until the event callbacks returned.
+// Afterwards its buffer is reused for newer frames
+extern SAMURE_RESULT(screencopy_stream)
+    samure_create_screencopy_stream(struct samure_context *ctx,
+                                    struct samure_output *output,
+                                    int capture_cursor);
+// public
+// The frames of events of the stream that have not been processed yet must not
+// be used anymore
+extern void
+samure_destroy_screencopy_stream(struct samure_context *ctx,
+                                 struct samure_screencopy_stream *s);
+
+// Handlers of the events of the frame in flight
+extern void
+samure_screencopy_stream_buffer(struct samure_screencopy_stream *s,
+                                uint32_t format, int32_t width,
+                                int32_t height, int32_t stride);
+extern void samure_screencopy_stream_copy(struct samure_screencopy_stream *s);
+extern void
+samure_screencopy_stream_damage(struct samure_screencopy_stream *s,
+                                struct samure_rect damage);
+extern void samure_screencopy_stream_ready(struct samure_screencopy_stream *s,
+                                           double time);
+extern void samure_screencopy_stream_failed(struct samure_screencopy_stream *s,
+                                            samure_error error);
+// Releases the frame of a SCREENCOPY_FRAME event after the event callbacks
+// returned
+extern void
+samure_screencopy_stream_frame_processed(struct samure_screencopy_stream *s,
+                                         struct samure_screencopy_frame *f);
+// Requests the next frame if it has been skipped because the event of the
+// frame in its buffer had not been processed yet
+extern void
+samure_screencopy_stream_resume(struct samure_screencopy_stream *s);
+// Stops capturing the output because it is about to be destroyed
+extern void
+samure_screencopy_stream_stop(struct samure_screencopy_stream *s);
@@ -39,20 +39,9 @@ samure_create_seat(struct samure_context *ctx, struct wl_seat *seat) {
 
   s->seat = seat;
 
+  // The input devices are created once the capabilities arrive
   wl_seat_add_listener(s->seat, &seat_listener,
                        samure_create_callback_data(ctx, s));
-  wl_display_roundtrip(ctx->display);
-  struct samure_callback_data *cbd = samure_create_callback_data(ctx, s);
-
-  if (s->pointer) {
-    wl_pointer_add_listener(s->pointer, &pointer_listener, cbd);
-  }
-  if (s->keyboard) {
-    wl_keyboard_add_listener(s->keyboard, &keyboard_listener, cbd);
-  }
-  if (s->touch) {
-    wl_touch_add_listener(s->touch, &touch_listener, cbd);
-  }
 
   SAMURE_RETURN_RESULT(seat, s);
 }
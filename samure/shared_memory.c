@@ -24,22 +24,53 @@
  * distribution.
  ************************************************************************************/
 
+#define _GNU_SOURCE
 #include "shared_memory.h"
+#include "callbacks.h"
+#include "pixel_format.h"
+#include "worker_pool.h"
 #include <errno.h>
 #include <fcntl.h>
 #include <string.h>
 #include <sys/mman.h>
-#include <time.h>
 #include <unistd.h>
 
-#define SHM_FILE_NAME "/samure-shared-memory"
-
 SAMURE_DEFINE_RESULT_UNWRAP(shared_buffer);
+SAMURE_DEFINE_RESULT_UNWRAP(shm_arena);
+
+static size_t samure_align(size_t value, size_t alignment) {
+  return (value + alignment - 1) / alignment * alignment;
+}
+
+// Creates an anonymous shared memory file that can not be shrunk, so that
+// the compositor never reads past the end of it
+static int samure_create_shm_file(const char *name, unsigned int flags) {
+  const int fd = memfd_create(name, MFD_CLOEXEC | MFD_ALLOW_SEALING | flags);
+  if (fd < 0) {
+    return fd;
+  }
+
+  if (fcntl(fd, F_ADD_SEALS, F_SEAL_SHRINK) < 0) {
+    DEBUG_PRINTF("failed to seal shared memory file errno=%d\n", errno);
+  }
+
+  return fd;
+}
 
 SAMURE_RESULT(shared_buffer)
 samure_create_shared_buffer(struct wl_shm *shm, uint32_t format, int32_t width,
                             int32_t height) {
-  DEBUG_PRINTF("create_shared_buffer width=%d height=%d\n", width, height);
+  return samure_create_shared_buffer_with_stride(
+      shm, format, width, height,
+      width * (int32_t)samure_format_bytes_per_pixel(format));
+}
+
+SAMURE_RESULT(shared_buffer)
+samure_create_shared_buffer_with_stride(struct wl_shm *shm, uint32_t format,
+                                        int32_t width, int32_t height,
+                                        int32_t stride) {
+  DEBUG_PRINTF("create_shared_buffer width=%d height=%d stride=%d\n", width,
+               height, stride);
 
   if (!shm) {
     SAMURE_RETURN_ERROR(shared_buffer, SAMURE_ERROR_NO_SHM);
@@ -50,34 +81,12 @@ samure_create_shared_buffer(struct wl_shm *shm, uint32_t format, int32_t width,
   b->width = width;
   b->height = height;
   b->format = format;
+  b->stride = stride;
 
-  const int32_t stride = width * 4;
-  const int32_t size = stride * height;
-
-  // Create shared memory file with random unique name
-  char file_name[] = SHM_FILE_NAME "-XXXXXX";
-  const size_t file_name_len = strlen(file_name);
-  int retries = 100;
-
-  do {
-    struct timespec ts;
-    clock_gettime(CLOCK_REALTIME, &ts);
-    long r = ts.tv_nsec;
-    char *buf = &file_name[file_name_len - 6];
-    for (int i = 0; i < 6; i++) {
-      buf[i] = 'A' + (r & 15) + (r & 16) * 2;
-      r >>= 5;
-    }
-
-    retries--;
-
-    b->fd = shm_open(file_name, O_RDWR | O_CREAT | O_EXCL, 0600);
-    if (b->fd >= 0) {
-      shm_unlink(file_name);
-      break;
-    }
-  } while (retries > 0 && errno == EEXIST);
+  const int32_t size = b->stride * height;
+  b->size = size;
 
+  b->fd = samure_create_shm_file("samure-shared-memory", 0);
   if (b->fd < 0) {
     SAMURE_DESTROY_ERROR(shared_buffer, b, SAMURE_ERROR_SHARED_BUFFER_FD_INIT);
   }
@@ -97,49 +106,461 @@ samure_create_shared_buffer(struct wl_shm *shm, uint32_t format, int32_t width,
     SAMURE_DESTROY_ERROR(shared_buffer, b,
                          SAMURE_ERROR_SHARED_BUFFER_POOL_INIT);
   }
-  b->buffer = wl_shm_pool_create_buffer(pool, 0, width, height, stride, format);
+  b->buffer =
+      wl_shm_pool_create_buffer(pool, 0, width, height, b->stride, format);
   wl_shm_pool_destroy(pool);
   if (!b->buffer) {
     SAMURE_DESTROY_ERROR(shared_buffer, b,
                          SAMURE_ERROR_SHARED_BUFFER_BUFFER_INIT);
   }
+  wl_buffer_add_listener(b->buffer, &buffer_listener, b);
 
   SAMURE_RETURN_RESULT(shared_buffer, b);
 }
 
+static void samure_shm_arena_free(struct samure_shm_arena *a, size_t offset);
+static void samure_shm_arena_remove_buffer(struct samure_shm_arena *a,
+                                           struct samure_shared_buffer *b);
+static void samure_shm_arena_free_memory(struct samure_shm_arena *a);
+
 void samure_destroy_shared_buffer(struct samure_shared_buffer *b) {
-  if (b->data)
-    munmap(b->data, b->width * b->height * 4);
-  if (b->fd >= 0)
-    close(b->fd);
+  if (b->arena && b->buffer && b->busy) {
+    // The compositor might still read from the block, so it can not be
+    // reused yet. buffer_release destroys the buffer
+    b->destroyed = 1;
+    b->on_release = NULL;
+    return;
+  }
+
   if (b->buffer)
     wl_buffer_destroy(b->buffer);
+  if (b->arena) {
+    struct samure_shm_arena *a = b->arena;
+    samure_shm_arena_remove_buffer(a, b);
+    if (!a->destroyed) {
+      samure_shm_arena_free(a, b->offset);
+    } else if (a->num_buffers == 0) {
+      samure_shm_arena_free_memory(a);
+    }
+  } else {
+    if (b->data)
+      munmap(b->data, b->size);
+    if (b->fd >= 0)
+      close(b->fd);
+  }
   free(b);
 }
 
+SAMURE_RESULT(shm_arena)
+samure_create_shm_arena(struct wl_shm *shm, enum samure_huge_pages huge_pages) {
+  if (!shm) {
+    SAMURE_RETURN_ERROR(shm_arena, SAMURE_ERROR_NO_SHM);
+  }
+
+  SAMURE_RESULT_ALLOC(shm_arena, a);
+
+  a->shm = shm;
+  a->fd = -1;
+  a->huge_pages = huge_pages;
+
+  // Reserve the address space for the whole arena, so that growing the pool
+  // never moves the data of the buffers. The start is aligned to huge pages,
+  // which is required for hugetlb and transparent huge pages
+  a->reserved_size = SAMURE_SHM_ARENA_MAX_SIZE + SAMURE_HUGE_PAGE_SIZE;
+  a->reserved_data = mmap(NULL, a->reserved_size, PROT_NONE,
+                          MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+  if (a->reserved_data == MAP_FAILED) {
+    a->reserved_data = NULL;
+    SAMURE_DESTROY_ERROR(shm_arena, a, SAMURE_ERROR_SHARED_BUFFER_MMAP);
+  }
+  a->data = (uint8_t *)samure_align((size_t)a->reserved_data,
+                                    SAMURE_HUGE_PAGE_SIZE);
+
+  if (a->huge_pages == SAMURE_HUGE_PAGES_HUGETLB) {
+    a->fd = samure_create_shm_file("samure-shm-arena", MFD_HUGETLB);
+    if (a->fd < 0) {
+      DEBUG_PRINTF("hugetlb is not available errno=%d\n", errno);
+      a->huge_pages = SAMURE_HUGE_PAGES_TRANSPARENT;
+    }
+  }
+
+  if (a->fd < 0) {
+    a->fd = samure_create_shm_file("samure-shm-arena", 0);
+    if (a->fd < 0) {
+      SAMURE_DESTROY_ERROR(shm_arena, a, SAMURE_ERROR_SHARED_BUFFER_FD_INIT);
+    }
+  }
+
+  SAMURE_RETURN_RESULT(shm_arena, a);
+}
+
+static void samure_shm_arena_free_memory(struct samure_shm_arena *a) {
+  if (a->reserved_data)
+    munmap(a->reserved_data, a->reserved_size);
+  if (a->fd >= 0)
+    close(a->fd);
+  free(a->blocks);
+  free(a->buffers);
+  free(a);
+}
+
+void samure_destroy_shm_arena(struct samure_shm_arena *a) {
+  // Going backwards, so that removing a buffer only moves ones that have
+  // already been visited
+  for (size_t i = a->num_buffers; i > 0; i--) {
+    struct samure_shared_buffer *b = a->buffers[i - 1];
+    if (b->buffer) {
+      wl_buffer_destroy(b->buffer);
+      b->buffer = NULL;
+    }
+    if (b->destroyed) {
+      samure_shm_arena_remove_buffer(a, b);
+      free(b);
+    }
+  }
+
+  if (a->pool) {
+    wl_shm_pool_destroy(a->pool);
+    a->pool = NULL;
+  }
+
+  // The application still owns some buffers which need the memory
+  a->destroyed = 1;
+  if (a->num_buffers == 0) {
+    samure_shm_arena_free_memory(a);
+  }
+}
+
+static samure_error
+samure_shm_arena_add_buffer(struct samure_shm_arena *a,
+                            struct samure_shared_buffer *b) {
+  if (a->num_buffers == a->cap_buffers) {
+    const size_t new_cap = a->cap_buffers == 0 ? 16 : a->cap_buffers * 2;
+    struct samure_shared_buffer **new_buffers =
+        realloc(a->buffers, new_cap * sizeof(struct samure_shared_buffer *));
+    if (!new_buffers) {
+      return SAMURE_ERROR_MEMORY;
+    }
+    a->buffers = new_buffers;
+    a->cap_buffers = new_cap;
+  }
+
+  a->buffers[a->num_buffers] = b;
+  a->num_buffers++;
+
+  return SAMURE_ERROR_NONE;
+}
+
+static void samure_shm_arena_remove_buffer(struct samure_shm_arena *a,
+                                           struct samure_shared_buffer *b) {
+  for (size_t i = 0; i < a->num_buffers; i++) {
+    if (a->buffers[i] == b) {
+      a->buffers[i] = a->buffers[a->num_buffers - 1];
+      a->num_buffers--;
+      return;
+    }
+  }
+}
+
+static samure_error samure_shm_arena_insert_block(struct samure_shm_arena *a,
+                                                  size_t index,
+                                                  struct samure_shm_block b) {
+  if (a->num_blocks == a->cap_blocks) {
+    const size_t new_cap = a->cap_blocks == 0 ? 16 : a->cap_blocks * 2;
+    struct samure_shm_block *new_blocks =
+        realloc(a->blocks, new_cap * sizeof(struct samure_shm_block));
+    if (!new_blocks) {
+      return SAMURE_ERROR_MEMORY;
+    }
+    a->blocks = new_blocks;
+    a->cap_blocks = new_cap;
+  }
+
+  memmove(&a->blocks[index + 1], &a->blocks[index],
+          (a->num_blocks - index) * sizeof(struct samure_shm_block));
+  a->blocks[index] = b;
+  a->num_blocks++;
+
+  return SAMURE_ERROR_NONE;
+}
+
+static void samure_shm_arena_remove_block(struct samure_shm_arena *a,
+                                          size_t index) {
+  memmove(&a->blocks[index], &a->blocks[index + 1],
+          (a->num_blocks - index - 1) * sizeof(struct samure_shm_block));
+  a->num_blocks--;
+}
+
+static samure_error samure_shm_arena_grow(struct samure_shm_arena *a,
+                                          size_t min_size) {
+  size_t new_size = a->size * 2;
+  if (new_size < a->size + SAMURE_SHM_ARENA_MIN_GROW_SIZE) {
+    new_size = a->size + SAMURE_SHM_ARENA_MIN_GROW_SIZE;
+  }
+  if (new_size < min_size) {
+    new_size = min_size;
+  }
+  new_size = samure_align(new_size, a->huge_pages == SAMURE_HUGE_PAGES_HUGETLB
+                                        ? SAMURE_HUGE_PAGE_SIZE
+                                        : (size_t)sysconf(_SC_PAGESIZE));
+
+  if (new_size > SAMURE_SHM_ARENA_MAX_SIZE) {
+    if (min_size > SAMURE_SHM_ARENA_MAX_SIZE) {
+      return SAMURE_ERROR_MEMORY;
+    }
+    new_size = SAMURE_SHM_ARENA_MAX_SIZE;
+  }
+
+  DEBUG_PRINTF("shm_arena_grow size=%zu new_size=%zu\n", a->size, new_size);
+
+  if (ftruncate(a->fd, new_size) < 0) {
+    return SAMURE_ERROR_SHARED_BUFFER_TRUNCATE;
+  }
+
+  void *data = mmap(a->data + a->size, new_size - a->size,
+                    PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, a->fd,
+                    a->size);
+  if (data == MAP_FAILED) {
+    if (a->huge_pages == SAMURE_HUGE_PAGES_HUGETLB && a->size == 0) {
+      // Not enough huge pages are reserved. Since nothing has been allocated
+      // yet the arena can still switch to normal pages
+      DEBUG_PRINTF("failed to map huge pages errno=%d\n", errno);
+      const int fd = samure_create_shm_file("samure-shm-arena", 0);
+      if (fd < 0) {
+        return SAMURE_ERROR_SHARED_BUFFER_FD_INIT;
+      }
+      close(a->fd);
+      a->fd = fd;
+      a->huge_pages = SAMURE_HUGE_PAGES_TRANSPARENT;
+      return samure_shm_arena_grow(a, min_size);
+    }
+    return SAMURE_ERROR_SHARED_BUFFER_MMAP;
+  }
+
+  if (a->huge_pages == SAMURE_HUGE_PAGES_TRANSPARENT) {
+    if (madvise(data, new_size - a->size, MADV_HUGEPAGE) < 0) {
+      DEBUG_PRINTF("madvise MADV_HUGEPAGE failed errno=%d\n", errno);
+    }
+  }
+
+  if (a->pool) {
+    wl_shm_pool_resize(a->pool, new_size);
+  } else {
+    a->pool = wl_shm_create_pool(a->shm, a->fd, new_size);
+    if (!a->pool) {
+      return SAMURE_ERROR_SHARED_BUFFER_POOL_INIT;
+    }
+  }
+
+  if (a->num_blocks != 0 && a->blocks[a->num_blocks - 1].free) {
+    a->blocks[a->num_blocks - 1].size += new_size - a->size;
+  } else {
+    struct samure_shm_block b = {
+        .offset = a->size,
+        .size = new_size - a->size,
+        .free = 1,
+    };
+    const samure_error err =
+        samure_shm_arena_insert_block(a, a->num_blocks, b);
+    if (SAMURE_IS_ERROR(err)) {
+      return err;
+    }
+  }
+
+  a->size = new_size;
+
+  return SAMURE_ERROR_NONE;
+}
+
+// Best-fit allocation from the free blocks of the arena
+static samure_error samure_shm_arena_alloc(struct samure_shm_arena *a,
+                                           size_t size, size_t *offset) {
+  size = samure_align(size, SAMURE_SHM_ARENA_ALIGNMENT);
+
+  size_t best = a->num_blocks;
+  for (size_t i = 0; i < a->num_blocks; i++) {
+    if (a->blocks[i].free && a->blocks[i].size >= size &&
+        (best == a->num_blocks || a->blocks[i].size < a->blocks[best].size)) {
+      best = i;
+    }
+  }
+
+  if (best == a->num_blocks) {
+    size_t min_size = a->size + size;
+    if (a->num_blocks != 0 && a->blocks[a->num_blocks - 1].free) {
+      min_size -= a->blocks[a->num_blocks - 1].size;
+    }
+
+    const samure_error err = samure_shm_arena_grow(a, min_size);
+    if (SAMURE_IS_ERROR(err)) {
+      return err;
+    }
+
+    best = a->num_blocks - 1;
+  }
+
+  if (a->blocks[best].size > size) {
+    struct samure_shm_block rest = {
+        .offset = a->blocks[best].offset + size,
+        .size = a->blocks[best].size - size,
+        .free = 1,
+    };
+    // If the block can not be split the whole block is used
+    if (!SAMURE_IS_ERROR(samure_shm_arena_insert_block(a, best + 1, rest))) {
+      a->blocks[best].size = size;
+    }
+  }
+
+  a->blocks[best].free = 0;
+  *offset = a->blocks[best].offset;
+
+  return SAMURE_ERROR_NONE;
+}
+
+static void samure_shm_arena_free(struct samure_shm_arena *a, size_t offset) {
+  size_t low = 0;
+  size_t high = a->num_blocks;
+  while (low < high) {
+    const size_t mid = low + (high - low) / 2;
+    if (a->blocks[mid].offset < offset) {
+      low = mid + 1;
+    } else {
+      high = mid;
+    }
+  }
+
+  if (low == a->num_blocks || a->blocks[low].offset != offset) {
+    DEBUG_PRINTF("shm_arena_free unknown offset=%zu\n", offset);
+    return;
+  }
+
+  size_t i = low;
+  a->blocks[i].free = 1;
+
+  // Merge with the neighbouring free blocks
+  if (i + 1 < a->num_blocks && a->blocks[i + 1].free) {
+    a->blocks[i].size += a->blocks[i + 1].size;
+    samure_shm_arena_remove_block(a, i + 1);
+  }
+  if (i > 0 && a->blocks[i - 1].free) {
+    a->blocks[i - 1].size += a->blocks[i].size;
+    samure_shm_arena_remove_block(a, i);
+  }
+}
+
+SAMURE_RESULT(shared_buffer)
+samure_shm_arena_create_buffer(struct samure_shm_arena *a, uint32_t format,
+                               int32_t width, int32_t height) {
+  return samure_shm_arena_create_buffer_with_stride(
+      a, format, width, height,
+      width * (int32_t)samure_format_bytes_per_pixel(format));
+}
+
+SAMURE_RESULT(shared_buffer)
+samure_shm_arena_create_buffer_with_stride(struct samure_shm_arena *a,
+                                           uint32_t format, int32_t width,
+                                           int32_t height, int32_t stride) {
+  DEBUG_PRINTF("shm_arena_create_buffer width=%d height=%d stride=%d\n", width,
+               height, stride);
+
+  SAMURE_RESULT_ALLOC(shared_buffer, b);
+
+  b->fd = -1;
+  b->width = width;
+  b->height = height;
+  b->format = format;
+  b->stride = stride;
+  b->size = (size_t)b->stride * (size_t)height;
+
+  const samure_error err = samure_shm_arena_alloc(a, b->size, &b->offset);
+  if (SAMURE_IS_ERROR(err)) {
+    // Fall back to a buffer with its own pool
+    DEBUG_PRINTF("shm_arena_create_buffer failed to allocate %zu bytes\n",
+                 b->size);
+    free(b);
+    return samure_create_shared_buffer_with_stride(a->shm, format, width,
+                                                   height, stride);
+  }
+
+  if (SAMURE_IS_ERROR(samure_shm_arena_add_buffer(a, b))) {
+    samure_shm_arena_free(a, b->offset);
+    free(b);
+    SAMURE_RETURN_ERROR(shared_buffer, SAMURE_ERROR_MEMORY);
+  }
+
+  b->arena = a;
+  b->data = a->data + b->offset;
+
+  b->buffer = wl_shm_pool_create_buffer(a->pool, (int32_t)b->offset, width,
+                                        height, b->stride, format);
+  if (!b->buffer) {
+    SAMURE_DESTROY_ERROR(shared_buffer, b,
+                         SAMURE_ERROR_SHARED_BUFFER_BUFFER_INIT);
+  }
+  wl_buffer_add_listener(b->buffer, &buffer_listener, b);
+
+  SAMURE_RETURN_RESULT(shared_buffer, b);
+}
+
 extern samure_error
 samure_shared_buffer_copy(struct samure_shared_buffer *dst,
                           struct samure_shared_buffer *src) {
-  if (src->format == dst->format && dst->width == src->width &&
-      dst->height == src->height) {
-    memcpy(dst->data, src->data, dst->width * dst->height * 4);
-    return SAMURE_ERROR_NONE;
+  if (dst->width != src->width || dst->height != src->height) {
+    return SAMURE_ERROR_FAILED;
   }
 
-  if (src->format != WL_SHM_FORMAT_XBGR8888 ||
-      dst->format != SAMURE_BUFFER_FORMAT || dst->width != src->width ||
-      dst->height != src->height) {
+  return samure_convert_pixels(dst->data, dst->stride, dst->format, src->data,
+                               src->stride, src->format, src->width,
+                               src->height);
+}
+
+struct samure_copy_job {
+  struct samure_shared_buffer *dst;
+  struct samure_shared_buffer *src;
+  int32_t rows_per_band;
+};
+
+static void samure_shared_buffer_copy_band(void *data, size_t index) {
+  const struct samure_copy_job *j = (const struct samure_copy_job *)data;
+
+  const int32_t y = (int32_t)index * j->rows_per_band;
+  int32_t rows = j->src->height - y;
+  if (rows > j->rows_per_band) {
+    rows = j->rows_per_band;
+  }
+
+  samure_convert_pixels((uint8_t *)j->dst->data + (size_t)y * j->dst->stride,
+                        j->dst->stride, j->dst->format,
+                        (uint8_t *)j->src->data + (size_t)y * j->src->stride,
+                        j->src->stride, j->src->format, j->src->width, rows);
+}
+
+samure_error
+samure_shared_buffer_copy_parallel(struct samure_worker_pool *pool,
+                                   struct samure_shared_buffer *dst,
+                                   struct samure_shared_buffer *src) {
+  if (dst->width != src->width || dst->height != src->height ||
+      !samure_can_convert_pixels(dst->format, src->format)) {
     return SAMURE_ERROR_FAILED;
   }
 
-  uint8_t *s = (uint8_t *)src->data;
-  uint8_t *d = (uint8_t *)dst->data;
-  for (size_t i = 0; i < dst->width * dst->height * 4; i += 4) {
-    d[i + 0] = s[i + 2]; // A
-    d[i + 1] = s[i + 1]; // B
-    d[i + 2] = s[i + 0]; // G
-    d[i + 3] = s[i + 3]; // R
+  if (dst->width == 0 || dst->height == 0 || dst->stride == 0) {
+    return SAMURE_ERROR_NONE;
+  }
+
+  struct samure_copy_job job = {
+      .dst = dst,
+      .src = src,
+      .rows_per_band = (int32_t)(SAMURE_COPY_BAND_SIZE / (size_t)dst->stride),
+  };
+  if (job.rows_per_band == 0) {
+    job.rows_per_band = 1;
   }
 
+  const size_t num_bands =
+      (dst->height + job.rows_per_band - 1) / job.rows_per_band;
+  samure_worker_pool_run(pool, num_bands, samure_shared_buffer_copy_band,
+                         &job);
+
   return SAMURE_ERROR_NONE;
 }
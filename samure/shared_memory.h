@@ -32,6 +32,32 @@
 
 #define SAMURE_BUFFER_FORMAT WL_SHM_FORMAT_ARGB8888
 
+// The maximum size of the shared memory pool of an arena. wl_shm_pool sizes
+// are limited to 32-bit
+#define SAMURE_SHM_ARENA_MAX_SIZE ((size_t)1 << 30)
+#define SAMURE_SHM_ARENA_MIN_GROW_SIZE ((size_t)4 << 20)
+#define SAMURE_SHM_ARENA_ALIGNMENT 64
+#define SAMURE_HUGE_PAGE_SIZE ((size_t)2 << 20)
+// Parallel copies are split into bands of rows of about this many bytes, so
+// that a band fits into the L2 cache
+#define SAMURE_COPY_BAND_SIZE ((size_t)256 << 10)
+
+struct samure_shm_arena;
+struct samure_worker_pool;
+
+// public
+enum samure_huge_pages {
+  SAMURE_HUGE_PAGES_NONE,
+  // Advise the kernel to back the shared memory with transparent huge pages.
+  // Only has an effect if /sys/kernel/mm/transparent_hugepage/shmem_enabled
+  // is set to advise
+  SAMURE_HUGE_PAGES_TRANSPARENT,
+  // Allocate the shared memory from the pre-reserved huge pages of hugetlbfs
+  // (see vm.nr_hugepages). Falls back to transparent huge pages if none are
+  // available
+  SAMURE_HUGE_PAGES_HUGETLB,
+};
+
 // public
 struct samure_shared_buffer {
   struct wl_buffer *buffer;
@@ -39,17 +65,96 @@ struct samure_shared_buffer {
   int fd;
   int32_t width;
   int32_t height;
+  int32_t stride; // Size of one row in bytes
   uint32_t format;
+  int busy; // Whether the buffer is currently used by the compositor
+  int destroyed; // Whether the buffer has been destroyed while it was busy.
+                 // Its memory is freed once the compositor released it
+  // Called when the compositor released the buffer
+  void (*on_release)(struct samure_shared_buffer *b, void *data);
+  void *release_data;
+
+  struct samure_shm_arena *arena; // The arena the buffer has been allocated
+                                  // from or NULL if it has its own pool
+  size_t offset;                  // Offset of the buffer inside the arena
+  size_t size;                    // Size of the buffer in bytes
+};
+
+struct samure_shm_block {
+  size_t offset;
+  size_t size;
+  int free;
+};
+
+// A single shared memory pool from which the buffers of all surfaces are
+// sub-allocated. The address space for the pool gets reserved up front so
+// that the data pointers of the buffers stay valid when the pool grows
+struct samure_shm_arena {
+  struct wl_shm *shm;
+  struct wl_shm_pool *pool;
+  int fd;
+  uint8_t *data;
+  size_t size;
+  enum samure_huge_pages huge_pages;
+
+  void *reserved_data;
+  size_t reserved_size;
+
+  struct samure_shm_block *blocks; // Sorted by offset
+  size_t num_blocks;
+  size_t cap_blocks;
+
+  // All buffers allocated from the arena that have not been freed yet
+  struct samure_shared_buffer **buffers;
+  size_t num_buffers;
+  size_t cap_buffers;
+  int destroyed; // The memory is kept until the last buffer is destroyed
 };
 
 SAMURE_DEFINE_RESULT(shared_buffer);
+SAMURE_DEFINE_RESULT(shm_arena);
 
 // public
 extern SAMURE_RESULT(shared_buffer)
     samure_create_shared_buffer(struct wl_shm *shm, uint32_t format,
                                 int32_t width, int32_t height);
 // public
+// Same as samure_create_shared_buffer, but with rows of stride bytes instead
+// of tightly packed ones (e.g. as requested by the compositor for screencopy)
+extern SAMURE_RESULT(shared_buffer)
+    samure_create_shared_buffer_with_stride(struct wl_shm *shm,
+                                            uint32_t format, int32_t width,
+                                            int32_t height, int32_t stride);
+// public
+// If the buffer comes from an arena and is still used by the compositor its
+// memory is only given back to the arena once the compositor released it
 extern void samure_destroy_shared_buffer(struct samure_shared_buffer *b);
 // public
+extern SAMURE_RESULT(shared_buffer)
+    samure_shm_arena_create_buffer(struct samure_shm_arena *a,
+                                   uint32_t format, int32_t width,
+                                   int32_t height);
+// public
+extern SAMURE_RESULT(shared_buffer)
+    samure_shm_arena_create_buffer_with_stride(struct samure_shm_arena *a,
+                                               uint32_t format, int32_t width,
+                                               int32_t height, int32_t stride);
+extern SAMURE_RESULT(shm_arena)
+    samure_create_shm_arena(struct wl_shm *shm,
+                            enum samure_huge_pages huge_pages);
+// Buffers of the arena that are still alive lose their wl_buffer, since the
+// connection is about to be closed, but their data stays valid until they are
+// destroyed with samure_destroy_shared_buffer
+extern void samure_destroy_shm_arena(struct samure_shm_arena *a);
+// public
+// Copies the pixels of src into dst converting between the pixel formats (see
+// samure_convert_pixels). Both buffers need to have the same size
 extern samure_error samure_shared_buffer_copy(struct samure_shared_buffer *dst,
                                               struct samure_shared_buffer *src);
+// public
+// Same as samure_shared_buffer_copy, but the rows are split into bands that
+// are converted in parallel on the threads of the pool
+extern samure_error
+samure_shared_buffer_copy_parallel(struct samure_worker_pool *pool,
+                                   struct samure_shared_buffer *dst,
+                                   struct samure_shared_buffer *src);
@@ -0,0 +1,125 @@
+/***********************************************************************************
+ *                         This file is part of samurai-render
+ *                    https://github.com/Samudevv/samurai-render
+ ***********************************************************************************
+ * Copyright (c) 2026 Kassandra Pucher
+ *
+ * This software is provided ‘as-is’, without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ * claim that you wrote the original software. If you use this software
+ * in a product, an acknowledgment in the product documentation would be
+ * appreciated but is not required.
+ *
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ * misrepresented as being the original software.
+ *
+ * 3. This notice may not be removed or altered from any source
+ * distribution.
+ ************************************************************************************/
+
+#include "swapchain.h"
+#include "callbacks.h"
+#include "context.h"
+
+struct samure_swapchain samure_init_swapchain(struct samure_context *ctx) {
+  struct samure_swapchain sc = {0};
+
+  sc.num_buffers = ctx->config.num_buffers;
+  if (sc.num_buffers == 0) {
+    sc.num_buffers = SAMURE_DEFAULT_SWAPCHAIN_BUFFERS;
+  } else if (sc.num_buffers > SAMURE_MAX_SWAPCHAIN_BUFFERS) {
+    sc.num_buffers = SAMURE_MAX_SWAPCHAIN_BUFFERS;
+  }
+
+  return sc;
+}
+
+void samure_destroy_swapchain(struct samure_swapchain *sc) {
+  for (size_t i = 0; i < sc->num_buffers; i++) {
+    if (sc->buffers[i]) {
+      samure_destroy_shared_buffer(sc->buffers[i]);
+      sc->buffers[i] = NULL;
+    }
+    sc->last_presented[i] = 0;
+  }
+}
+
+// Renders the layer surface that has been waiting for a free buffer
+static void samure_swapchain_buffer_released(struct samure_shared_buffer *b,
+                                             void *data) {
+  struct samure_layer_surface *sfc = (struct samure_layer_surface *)data;
+  if (sfc->no_buffer) {
+    sfc->no_buffer = 0;
+    samure_context_render_layer_surface(sfc->callback_data->ctx, sfc,
+                                        sfc->render_geo);
+  }
+}
+
+samure_error samure_swapchain_resize(struct samure_context *ctx,
+                                     struct samure_layer_surface *sfc,
+                                     struct samure_swapchain *sc) {
+  samure_error error_code = SAMURE_ERROR_NONE;
+
+  for (size_t i = 0; i < sc->num_buffers; i++) {
+    SAMURE_RESULT(shared_buffer)
+    b_rs = samure_create_shared_buffer_for_layer_surface(ctx, sfc,
+                                                         sc->buffers[i]);
+    if (SAMURE_HAS_ERROR(b_rs)) {
+      sc->buffers[i] = NULL;
+      sc->last_presented[i] = 0;
+      error_code |= SAMURE_ERROR_SHARED_BUFFER_INIT | b_rs.error;
+      continue;
+    }
+
+    struct samure_shared_buffer *b = SAMURE_UNWRAP(shared_buffer, b_rs);
+    if (b != sc->buffers[i]) {
+      b->on_release = samure_swapchain_buffer_released;
+      b->release_data = sfc;
+      sc->buffers[i] = b;
+      sc->last_presented[i] = 0;
+    }
+  }
+
+  return error_code;
+}
+
+struct samure_shared_buffer *
+samure_swapchain_acquire(struct samure_swapchain *sc) {
+  for (size_t i = 0; i < sc->num_buffers; i++) {
+    // Start searching after the current buffer so that the buffers are used
+    // in a round robin fashion
+    const size_t index = (sc->current + 1 + i) % sc->num_buffers;
+    if (sc->buffers[index] && !sc->buffers[index]->busy) {
+      sc->current = index;
+      return sc->buffers[index];
+    }
+  }
+
+  return NULL;
+}
+
+uint64_t samure_swapchain_buffer_age(struct samure_swapchain *sc) {
+  if (!sc->buffers[sc->current] || sc->last_presented[sc->current] == 0) {
+    return 0;
+  }
+  return sc->num_presented - sc->last_presented[sc->current] + 1;
+}
+
+void samure_swapchain_present(struct samure_layer_surface *sfc,
+                              struct samure_swapchain *sc) {
+  struct samure_shared_buffer *b = sc->buffers[sc->current];
+  if (!b) {
+    return;
+  }
+
+  sc->num_presented++;
+  sc->last_presented[sc->current] = sc->num_presented;
+  samure_layer_surface_draw_buffer(sfc, b);
+}
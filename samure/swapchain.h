@@ -0,0 +1,73 @@
+/***********************************************************************************
+ *                         This file is part of samurai-render
+ *                    https://github.com/Samudevv/samurai-render
+ ***********************************************************************************
+ * Copyright (c) 2026 Kassandra Pucher
+ *
+ * This software is provided ‘as-is’, without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ * claim that you wrote the original software. If you use this software
+ * in a product, an acknowledgment in the product documentation would be
+ * appreciated but is not required.
+ *
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ * misrepresented as being the original software.
+ *
+ * 3. This notice may not be removed or altered from any source
+ * distribution.
+ ************************************************************************************/
+
+#pragma once
+
+#include <stdint.h>
+
+#include "error_handling.h"
+#include "shared_memory.h"
+
+#define SAMURE_MAX_SWAPCHAIN_BUFFERS 3
+#define SAMURE_DEFAULT_SWAPCHAIN_BUFFERS 1
+
+struct samure_context;
+struct samure_layer_surface;
+
+// public
+struct samure_swapchain {
+  struct samure_shared_buffer *buffers[SAMURE_MAX_SWAPCHAIN_BUFFERS];
+  uint64_t last_presented[SAMURE_MAX_SWAPCHAIN_BUFFERS];
+  size_t num_buffers;
+  size_t current;
+  uint64_t num_presented;
+};
+
+extern struct samure_swapchain
+samure_init_swapchain(struct samure_context *ctx);
+
+extern void samure_destroy_swapchain(struct samure_swapchain *sc);
+
+// Creates the buffers of the swap chain or resizes them if the size of the
+// layer surface changed
+extern samure_error samure_swapchain_resize(struct samure_context *ctx,
+                                            struct samure_layer_surface *sfc,
+                                            struct samure_swapchain *sc);
+
+// Selects a buffer that is not used by the compositor and returns it.
+// Returns NULL if all buffers are busy. Then the layer surface is rendered
+// again once the compositor releases one of them
+extern struct samure_shared_buffer *
+samure_swapchain_acquire(struct samure_swapchain *sc);
+
+// Returns the age of the current buffer in frames like EGL_EXT_buffer_age.
+// 1 means it contains the last presented frame, 2 the one before that and so
+// on. 0 means that the contents of the buffer are undefined
+extern uint64_t samure_swapchain_buffer_age(struct samure_swapchain *sc);
+
+// Attaches the current buffer to the layer surface and commits it
+extern void samure_swapchain_present(struct samure_layer_surface *sfc,
+                                     struct samure_swapchain *sc);
@@ -0,0 +1,142 @@
+/***********************************************************************************
+ *                         This file is part of samurai-render
+ *                    https://github.com/Samudevv/samurai-render
+ ***********************************************************************************
+ * Copyright (c) 2026 Kassandra Pucher
+ *
+ * This software is provided ‘as-is’, without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ * claim that you wrote the original software. If you use this software
+ * in a product, an acknowledgment in the product documentation would be
+ * appreciated but is not required.
+ *
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ * misrepresented as being the original software.
+ *
+ * 3. This notice may not be removed or altered from any source
+ * distribution.
+ ************************************************************************************/
+
+#include "worker_pool.h"
+#include <stdlib.h>
+#include <string.h>
+
+SAMURE_DEFINE_RESULT_UNWRAP(worker_pool);
+
+static void *samure_worker_pool_thread(void *data) {
+  struct samure_worker_pool *p = (struct samure_worker_pool *)data;
+
+  pthread_mutex_lock(&p->mutex);
+  for (;;) {
+    while (!p->quit && p->next_job >= p->num_jobs) {
+      pthread_cond_wait(&p->work_cond, &p->mutex);
+    }
+    if (p->quit) {
+      break;
+    }
+
+    const size_t index = p->next_job;
+    p->next_job++;
+
+    pthread_mutex_unlock(&p->mutex);
+    p->func(p->data, index);
+    pthread_mutex_lock(&p->mutex);
+
+    p->num_done_jobs++;
+    if (p->num_done_jobs == p->num_jobs) {
+      pthread_cond_signal(&p->done_cond);
+    }
+  }
+  pthread_mutex_unlock(&p->mutex);
+
+  return NULL;
+}
+
+SAMURE_RESULT(worker_pool) samure_create_worker_pool(size_t num_threads) {
+  SAMURE_RESULT_ALLOC(worker_pool, p);
+
+  pthread_mutex_init(&p->mutex, NULL);
+  pthread_cond_init(&p->work_cond, NULL);
+  pthread_cond_init(&p->done_cond, NULL);
+
+  if (num_threads == 0) {
+    SAMURE_RETURN_RESULT(worker_pool, p);
+  }
+
+  p->threads = malloc(num_threads * sizeof(pthread_t));
+  if (!p->threads) {
+    SAMURE_DESTROY_ERROR(worker_pool, p, SAMURE_ERROR_MEMORY);
+  }
+
+  for (size_t i = 0; i < num_threads; i++) {
+    if (pthread_create(&p->threads[i], NULL, samure_worker_pool_thread, p) !=
+        0) {
+      SAMURE_DESTROY_ERROR(worker_pool, p, SAMURE_ERROR_WORKER_POOL_INIT);
+    }
+    p->num_threads++;
+  }
+
+  SAMURE_RETURN_RESULT(worker_pool, p);
+}
+
+void samure_destroy_worker_pool(struct samure_worker_pool *p) {
+  pthread_mutex_lock(&p->mutex);
+  p->quit = 1;
+  pthread_cond_broadcast(&p->work_cond);
+  pthread_mutex_unlock(&p->mutex);
+
+  for (size_t i = 0; i < p->num_threads; i++) {
+    pthread_join(p->threads[i], NULL);
+  }
+
+  pthread_cond_destroy(&p->done_cond);
+  pthread_cond_destroy(&p->work_cond);
+  pthread_mutex_destroy(&p->mutex);
+  free(p->threads);
+  free(p);
+}
+
+void samure_worker_pool_run(struct samure_worker_pool *p, size_t num_jobs,
+                            samure_worker_func func, void *data) {
+  if (!p || p->num_threads == 0 || num_jobs < 2) {
+    for (size_t i = 0; i < num_jobs; i++) {
+      func(data, i);
+    }
+    return;
+  }
+
+  pthread_mutex_lock(&p->mutex);
+  p->func = func;
+  p->data = data;
+  p->num_jobs = num_jobs;
+  p->next_job = 0;
+  p->num_done_jobs = 0;
+  pthread_cond_broadcast(&p->work_cond);
+
+  while (p->next_job < p->num_jobs) {
+    const size_t index = p->next_job;
+    p->next_job++;
+
+    pthread_mutex_unlock(&p->mutex);
+    func(data, index);
+    pthread_mutex_lock(&p->mutex);
+
+    p->num_done_jobs++;
+  }
+
+  while (p->num_done_jobs < p->num_jobs) {
+    pthread_cond_wait(&p->done_cond, &p->mutex);
+  }
+
+  // Let the workers go back to sleep
+  p->num_jobs = 0;
+  p->next_job = 0;
+  pthread_mutex_unlock(&p->mutex);
+}
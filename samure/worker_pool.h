@@ -0,0 +1,69 @@
+/***********************************************************************************
+ *                         This file is part of samurai-render
+ *                    https://github.com/Samudevv/samurai-render
+ ***********************************************************************************
+ * Copyright (c) 2026 Kassandra Pucher
+ *
+ * This software is provided ‘as-is’, without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ * claim that you wrote the original software. If you use this software
+ * in a product, an acknowledgment in the product documentation would be
+ * appreciated but is not required.
+ *
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ * misrepresented as being the original software.
+ *
+ * 3. This notice may not be removed or altered from any source
+ * distribution.
+ ************************************************************************************/
+
+#pragma once
+
+#include <pthread.h>
+#include <stddef.h>
+
+#include "error_handling.h"
+
+// public
+// Executes one job of a batch. index is in the range [0, num_jobs)
+typedef void (*samure_worker_func)(void *data, size_t index);
+
+// public
+// A small pool of threads that executes batches of jobs in parallel
+struct samure_worker_pool {
+  pthread_t *threads;
+  size_t num_threads;
+
+  pthread_mutex_t mutex;
+  pthread_cond_t work_cond;
+  pthread_cond_t done_cond;
+
+  samure_worker_func func;
+  void *data;
+  size_t num_jobs;
+  size_t next_job;
+  size_t num_done_jobs;
+  int quit;
+};
+
+SAMURE_DEFINE_RESULT(worker_pool);
+
+// public
+extern SAMURE_RESULT(worker_pool) samure_create_worker_pool(size_t num_threads);
+// public
+extern void samure_destroy_worker_pool(struct samure_worker_pool *p);
+
+// public
+// Runs func for every index in [0, num_jobs) and waits until all jobs are
+// done. The calling thread executes jobs as well. If p is NULL all jobs are
+// executed on the calling thread. Must not be called from inside of a job
+extern void samure_worker_pool_run(struct samure_worker_pool *p,
+                                   size_t num_jobs, samure_worker_func func,
+                                   void *data);
@@ -126,6 +126,7 @@ target("samurai-render")
     set_kind("$(kind)")
     add_rules("utils.install.pkgconfig_importfiles")
     add_packages("wayland-client", "wayland-cursor")
+    add_syslinks("pthread")
     add_options(
         "backend_cairo",
         "backend_opengl"